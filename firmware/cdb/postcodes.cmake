@@ -0,0 +1,49 @@
+# POST code database: turns the plain text tables in this directory into
+# ${PROJECT_BINARY_DIR}/cfg/postcodes.inc, which src/postcodes.cpp hashes at
+# compile time, and their fingerprints into postsigs.inc for src/fingerprint.cpp.
+# Editing a table is enough for the next build to pick it up.
+#
+# Bump the project PATCH version (PROJ_CDB_VER) whenever a table changes.
+
+set(CDB_VENDORS Ami Award Phoenix Ibm Compaq)
+set(CDB_OUTPUT "${PROJECT_BINARY_DIR}/cfg/postcodes.inc")
+set(CDB_SIG_OUTPUT "${PROJECT_BINARY_DIR}/cfg/postsigs.inc")
+
+set(CDB_CONTENT "// Generated from cdb/*.txt by cdb/postcodes.cmake, do not edit\n")
+set(CDB_SIG_CONTENT "${CDB_CONTENT}")
+foreach(vendor IN LISTS CDB_VENDORS)
+    string(TOLOWER "${vendor}" table)
+    set(source "${CMAKE_CURRENT_LIST_DIR}/${table}.txt")
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${source}")
+
+    # Anything not starting with two hex digits or > is a comment
+    file(STRINGS "${source}" entries REGEX "^([0-9A-Fa-f][0-9A-Fa-f]|>)[ \t]")
+    foreach(entry IN LISTS entries)
+        if(entry MATCHES "^>")
+            if(NOT entry MATCHES "^>[ \t]+([^ \t]+)((([ \t]+[0-9A-Fa-f][0-9A-Fa-f])+))[ \t\r]*$")
+                message(FATAL_ERROR "${table}.txt: expected a version and codes in \"${entry}\"")
+            endif()
+            set(version "${CMAKE_MATCH_1}")
+            string(STRIP "${CMAKE_MATCH_2}" codes)
+            string(REGEX REPLACE "[ \t]+" ";" codes "${codes}")
+            list(LENGTH codes length)
+            list(TRANSFORM codes PREPEND "0x")
+            list(JOIN codes ", " codes)
+            string(APPEND CDB_SIG_CONTENT "{ BiosVendor::${vendor}, \"${version}\", ${length}, { ${codes} } },\n")
+            continue()
+        endif()
+        if(NOT entry MATCHES "^([0-9A-Fa-f][0-9A-Fa-f])[ \t]+([^\r]*[^ \t\r])")
+            message(FATAL_ERROR "${table}.txt: no description in \"${entry}\"")
+        endif()
+        set(code "${CMAKE_MATCH_1}")
+        string(REPLACE "\\" "\\\\" text "${CMAKE_MATCH_2}")
+        string(REPLACE "\"" "\\\"" text "${text}")
+        string(APPEND CDB_CONTENT "{ BiosVendor::${vendor}, 0x${code}, \"${text}\" },\n")
+    endforeach()
+endforeach()
+
+# Only touch the output when something changed, so that edits to comments don't rebuild
+file(WRITE "${CDB_OUTPUT}.tmp" "${CDB_CONTENT}")
+configure_file("${CDB_OUTPUT}.tmp" "${CDB_OUTPUT}" COPYONLY)
+file(WRITE "${CDB_SIG_OUTPUT}.tmp" "${CDB_SIG_CONTENT}")
+configure_file("${CDB_SIG_OUTPUT}.tmp" "${CDB_SIG_OUTPUT}" COPYONLY)
@@ -13,14 +13,48 @@
 #include "hardware/gpio.h"
 #include "hardware/vreg.h"
 #include "pico/bootrom.h"
+#include "pico/flash.h"
 #include "pico/stdlib.h"
 
+#include <algorithm>
+#include <array>
 #include <cstdio>
 #include <cstring>
 #include <vector>
 
+// Fixed port sets of the decoding readers, built into Logic's filter when each one starts
+static constexpr std::array<uint16_t, 2> MULTI_PORTS { 0x80, 0x84 };
+static constexpr std::array<uint16_t, 11> CONSOLE_PORTS {
+    ConsoleDecoder::c_uartBase, ConsoleDecoder::c_uartBase + 1, ConsoleDecoder::c_uartBase + 2,
+    ConsoleDecoder::c_uartBase + 3, ConsoleDecoder::c_uartBase + 4, ConsoleDecoder::c_uartBase + 5,
+    ConsoleDecoder::c_uartBase + 6, ConsoleDecoder::c_uartBase + 7,
+    ConsoleDecoder::c_debugPort, ConsoleDecoder::c_cmosIndex, ConsoleDecoder::c_cmosData
+};
+static constexpr std::array<uint16_t, 4> BEEP_PORTS {
+    0x80, BeepDecoder::c_pitCounter2, BeepDecoder::c_pitControl, BeepDecoder::c_speakerPort
+};
+
 std::unique_ptr<Application> Application::instance { nullptr };
 
+// Vendors the cdb command takes, then those whose tables have no entries yet
+static std::string CdbVendorList()
+{
+    std::string ready {};
+    std::string empty {};
+    for (uint8_t index = static_cast<uint8_t>(BiosVendor::None) + 1; index <= static_cast<uint8_t>(BiosVendor::Compaq); index++) {
+        const auto vendor = static_cast<BiosVendor>(index);
+        std::string& list = (PostCodeDatabase::Count(vendor) > 0) ? ready : empty;
+        list += PostCodeDatabase::VendorName(vendor);
+        list += ", ";
+    }
+    ready += "Off";
+    if (!empty.empty()) {
+        empty.resize(empty.size() - 2);
+        ready += " | No entries yet for " + empty;
+    }
+    return ready;
+}
+
 Application* Application::GetInstance()
 {
     if (Application::instance == nullptr) {
@@ -33,38 +67,89 @@ __attribute__((noreturn)) void Application::LogicTask()
 {
     auto self = Application::GetInstance();
 
+    // Flash writes from the other core park this one
+    flash_safe_execute_core_init();
+
     while (true) {
         if (self->hwMode == UserMode::Serial) {
-            self->logic->AddressReader(&self->dataQueue, false);
+            self->logic->AddressReader(&self->dataRing, false);
         } else {
             switch (self->app_currentSelect) {
 
             case ProgramSelect::BusDump: {
-                self->logic->AddressReader(&self->dataQueue, self->UseNewRemote(), Logic::AllAddresses);
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote(), Logic::AllAddresses,
+                    self->dumpEngine);
+            } break;
+
+            case ProgramSelect::CycleTiming: {
+                self->logic->CycleTiming();
             } break;
 
-            case ProgramSelect::Port80Reader: {
-                self->logic->AddressReader(&self->dataQueue, self->UseNewRemote());
+            case ProgramSelect::PortHeatmap: {
+                self->logic->PortInventory();
+            } break;
+
+            case ProgramSelect::Port80Reader:
+            case ProgramSelect::StageProfiler:
+            case ProgramSelect::GoldenMatch: {
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote());
             } break;
 
             case ProgramSelect::Port84Reader: {
-                self->logic->AddressReader(&self->dataQueue, self->UseNewRemote(), 0x84);
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote(), 0x84);
             } break;
 
             case ProgramSelect::Port90Reader: {
-                self->logic->AddressReader(&self->dataQueue, self->UseNewRemote(), 0x90);
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote(), 0x90);
             } break;
 
             case ProgramSelect::Port300Reader: {
-                self->logic->AddressReader(&self->dataQueue, self->UseNewRemote(), 0x300);
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote(), 0x300);
             } break;
 
             case ProgramSelect::Port378Reader: {
-                self->logic->AddressReader(&self->dataQueue, self->UseNewRemote(), 0x378);
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote(), 0x378);
+            } break;
+
+            case ProgramSelect::MultiPortReader: {
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote(), MULTI_PORTS);
+            } break;
+
+            case ProgramSelect::CustomReader: {
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote(), self->customFilter);
+            } break;
+
+            case ProgramSelect::WordReader: {
+                const std::array<uint16_t, 2> wordPorts { self->wordConfig.LowPort(), self->wordConfig.HighPort() };
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote(), wordPorts);
+            } break;
+
+            case ProgramSelect::ConsoleReader: {
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote(), CONSOLE_PORTS);
+            } break;
+
+            case ProgramSelect::BeepReader: {
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote(), BEEP_PORTS);
+            } break;
+
+            case ProgramSelect::BiosDetect: {
+                self->logic->AddressReader(&self->dataRing, self->UseNewRemote(), PostCodeDatabase::c_postPorts);
+            } break;
+
+            case ProgramSelect::DeepCapture: {
+                self->logic->DeepCapture(&self->dataRing, self->UseNewRemote());
             } break;
 
             case ProgramSelect::VoltageMonitor: {
-                self->logic->VoltageMonitor(&self->dataQueue);
+                self->logic->VoltageMonitor(&self->voltsQueue);
+            } break;
+
+            case ProgramSelect::BusClock: {
+                self->logic->ClockMeter(&self->clockQueue, self->UseNewRemote());
+            } break;
+
+            case ProgramSelect::Calibration: {
+                self->logic->CalibrateTiming(&self->dataRing);
             } break;
 
             default: {
@@ -80,6 +165,9 @@ __attribute__((noreturn)) void Application::UITask()
 {
     auto self = Application::GetInstance();
 
+    // Deep capture writes to flash from core 1, and parks this one meanwhile
+    flash_safe_execute_core_init();
+
     // Set up GPIO for appropriate keypress handling
     switch (self->hwMode) {
     case UserMode::I2CKeypad: {
@@ -120,6 +208,9 @@ __attribute__((noreturn)) void Application::UITask()
             self->Keystroke();
         }
 
+        // Handle commands coming from USB
+        self->PollSerialCommand();
+
         // Output data for user
         self->UserOutput();
 
@@ -252,9 +343,26 @@ void Application::Keystroke()
         if (this->keyboard.current & KE_Back) {
             this->app_newSelect = ProgramSelect::MainMenu;
             this->logic->Stop();
-            while (!queue_is_empty(&this->dataQueue)) {
-                QueueData bogus;
-                queue_remove_blocking(&this->dataQueue, &bogus);
+            this->dataRing.Clear();
+            if (this->app_currentSelect == ProgramSelect::StageProfiler) {
+                this->ui->PrintProfile();
+            } else if (this->app_currentSelect == ProgramSelect::DeepCapture) {
+                this->PrintDeepLog();
+            }
+            if (this->ReaderActive()) {
+                this->PrintLosses();
+            } else if (this->app_currentSelect == ProgramSelect::CycleTiming) {
+                this->PrintCycleStats();
+            } else if (this->app_currentSelect == ProgramSelect::PortHeatmap) {
+                this->PrintInventory();
+            }
+            while (!queue_is_empty(&this->voltsQueue)) {
+                VoltageSample bogus;
+                queue_remove_blocking(&this->voltsQueue, &bogus);
+            }
+            while (!queue_is_empty(&this->clockQueue)) {
+                ClockSample bogus;
+                queue_remove_blocking(&this->clockQueue, &bogus);
             }
             this->app_newMenuIdx = this->app_currentMenuIdx;
             this->app_currentMenuIdx = -1;
@@ -345,24 +453,130 @@ void Application::UserOutput()
         if (drawHeader) {
             this->ui->DrawHeader(this->ui->GetMenuEntry(this->app_currentMenuIdx).second);
             this->ui->DrawActions(bmp_back, bmp_empty, bmp_empty);
-
-            if (this->app_currentSelect == ProgramSelect::BusDump) {
+            this->ui->SetLanes(this->app_currentSelect == ProgramSelect::MultiPortReader
+                || this->app_currentSelect == ProgramSelect::CustomReader);
+            this->ui->SetWords(this->app_currentSelect == ProgramSelect::WordReader, this->wordConfig);
+            this->ui->SetConsole(this->app_currentSelect == ProgramSelect::ConsoleReader);
+            this->ui->SetBeeps(this->app_currentSelect == ProgramSelect::BeepReader);
+            this->ui->SetProfiler(this->app_currentSelect == ProgramSelect::StageProfiler);
+            this->ui->SetGolden(this->app_currentSelect == ProgramSelect::GoldenMatch);
+            this->ui->SetFingerprint(this->app_currentSelect == ProgramSelect::BiosDetect);
+            this->displayDropped = 0;
+            this->lastTrigger = Logic::TriggerState::Off;
+            this->heatmapTick = time_us_64() + c_heatmapPeriod;
+
+            if (this->app_currentSelect == ProgramSelect::BusDump
+                || this->app_currentSelect == ProgramSelect::CycleTiming) {
                 this->ui->DrawFooter("Connect to PC");
+            } else if (this->app_currentSelect == ProgramSelect::Calibration) {
+                this->ui->DrawFooter("Calibrating");
+            } else if (this->app_currentSelect == ProgramSelect::BusClock && !this->UseNewRemote()) {
+                this->ui->DrawFooter("Rev 6 only");
+            }
+        }
+
+        const uint volts = queue_get_level(&this->voltsQueue);
+        if (volts > 0) {
+            std::vector<VoltageSample> voltsList(volts);
+            for (uint idx = 0; idx < volts; idx++) {
+                queue_remove_blocking(&this->voltsQueue, &voltsList[idx]);
             }
+            this->lastActivityTimer = time_us_64();
+            this->ui->NewData(voltsList.data(), volts);
         }
 
-        const uint count = queue_get_level(&this->dataQueue);
-        if (count == 0) {
+        const uint clocks = queue_get_level(&this->clockQueue);
+        if (clocks > 0) {
+            std::vector<ClockSample> clockList(clocks);
+            for (uint idx = 0; idx < clocks; idx++) {
+                queue_remove_blocking(&this->clockQueue, &clockList[idx]);
+            }
+            this->lastActivityTimer = time_us_64();
+            this->ui->NewData(clockList.data(), clocks);
+        }
+
+        if (this->app_currentSelect == ProgramSelect::PortHeatmap && time_us_64() >= this->heatmapTick) {
+            // Counters keep going on core 1, only a snapshot of the busiest ports gets shown
+            std::array<PortHeatmap::Entry, c_heatmapTop> top {};
+            this->logic->GetHeatmap(this->heatmap);
+            const size_t count = this->heatmap.Top(top);
+            if (count > 0) {
+                this->lastActivityTimer = time_us_64();
+            }
+            this->ui->NewData(top.data(), count, this->heatmap.Total());
+            this->heatmapTick = time_us_64() + c_heatmapPeriod;
+        }
+
+        const auto trigger = this->logic->GetTriggerState();
+        if (trigger != this->lastTrigger) {
+            this->lastTrigger = trigger;
+            switch (trigger) {
+            case Logic::TriggerState::Armed: {
+                this->ui->DrawFooter("Armed");
+                printf("Trigger armed\n");
+            } break;
+
+            case Logic::TriggerState::Triggered: {
+                this->ui->DrawFooter("Triggered");
+            } break;
+
+            case Logic::TriggerState::Frozen: {
+                this->ui->DrawFooter("Frozen");
+            } break;
+
+            default: {
+                // reader is quitting, nothing to say
+            } break;
+            }
+        }
+
+        if (trigger == Logic::TriggerState::Armed) {
+            // Until the trigger fires, only the pre-trigger window is worth keeping
+            const size_t level = this->dataRing.Level();
+            size_t toSkip = (level > this->triggerPre) ? (level - this->triggerPre) : 0;
+            while (toSkip > 0) {
+                const auto events = this->dataRing.Peek();
+                const size_t count = std::min(toSkip, events.size());
+                this->ui->SkipData(events.data(), count, false);
+                this->dataRing.Release(count);
+                toSkip -= count;
+            }
             break;
+        } else if (trigger == Logic::TriggerState::Triggered) {
+            // Everything gets shown at once, when the post-trigger window is complete
+            break;
+        }
+
+        const size_t backlog = this->dataRing.Level();
+        if (this->overflowPolicy == OverflowPolicy::DropOldest && backlog > c_trimBacklog) {
+            // Way behind: skip the oldest events and get back close to real time
+            size_t toSkip = backlog - c_keepBacklog;
+            while (toSkip > 0) {
+                const auto events = this->dataRing.Peek();
+                const size_t count = std::min(toSkip, events.size());
+                this->displayDropped += this->ui->SkipData(events.data(), count);
+                this->dataRing.Release(count);
+                toSkip -= count;
+            }
         }
 
-        std::vector<QueueData> dataList {};
-        dataList.reserve(count);
-        for (uint idx = 0; idx < count; idx++) {
-            queue_remove_blocking(&this->dataQueue, &dataList[idx]);
+        // Capture is waiting on us, OLED refreshes can wait instead
+        const bool throttle = (this->overflowPolicy == OverflowPolicy::Lossless && backlog > c_throttleBacklog);
+
+        // Events are read in place, in two chunks if the ring wrapped around
+        for (uint chunk = 0; chunk < 2; chunk++) {
+            const auto events = this->dataRing.Peek();
+            if (events.empty()) {
+                if (chunk == 0) {
+                    this->ui->ExpirePending();
+                }
+                break;
+            }
+            this->lastActivityTimer = time_us_64();
+            this->ui->NewData(events.data(), events.size(),
+                this->app_currentSelect != ProgramSelect::BusDump && !throttle);
+            this->dataRing.Release(events.size());
         }
-        this->lastActivityTimer = time_us_64();
-        this->ui->NewData(dataList.data(), count, this->app_currentSelect != ProgramSelect::BusDump);
     } break;
     }
 }
@@ -422,6 +636,328 @@ void Application::StandbyTick()
     }
 }
 
+void Application::PollSerialCommand()
+{
+    int incoming = getchar_timeout_us(0);
+    while (incoming != PICO_ERROR_TIMEOUT) {
+        if (incoming == '\r' || incoming == '\n') {
+            if (!this->serialCommand.empty()) {
+                this->RunSerialCommand(this->serialCommand);
+                this->serialCommand.clear();
+            }
+        } else if (this->serialCommand.size() < c_maxCommandLength) {
+            this->serialCommand.push_back(static_cast<char>(incoming));
+        }
+        incoming = getchar_timeout_us(0);
+    }
+}
+
+void Application::RunSerialCommand(std::string_view command)
+{
+    // filter <spec>: sets the ports used by the "Custom filter" reader, see PortFilter::Parse
+    static constexpr std::string_view filterCmd { "filter " };
+    if (command.starts_with(filterCmd)) {
+        if (this->app_currentSelect == ProgramSelect::CustomReader) {
+            printf("Filter KO! -> Stop the custom reader first\n");
+        } else if (this->customFilter.Parse(command.substr(filterCmd.size()))) {
+            printf("Filter OK! -> %u ports\n", static_cast<unsigned int>(this->customFilter.Count()));
+        } else {
+            printf("Filter KO! -> Expected something like 80,84,3F8-3FF\n");
+        }
+    } else if (command.starts_with("word ")) {
+        // word <port> [window]: low port in hex, pairing window in us
+        if (this->app_currentSelect == ProgramSelect::WordReader) {
+            printf("Word KO! -> Stop the 16-bit reader first\n");
+        } else if (this->wordConfig.Parse(command.substr(5))) {
+            printf("Word OK! -> %04Xh+%04Xh within %u us\n", this->wordConfig.LowPort(), this->wordConfig.HighPort(),
+                static_cast<unsigned int>(this->wordConfig.WindowUs()));
+        } else {
+            printf("Word KO! -> Expected something like 80 or 84 200\n");
+        }
+    } else if (command == "policy newest") {
+        this->overflowPolicy = OverflowPolicy::DropNewest;
+        this->logic->SetOverflowPolicy(this->overflowPolicy);
+        printf("Policy OK! -> Drop newest\n");
+    } else if (command == "policy oldest") {
+        this->overflowPolicy = OverflowPolicy::DropOldest;
+        this->logic->SetOverflowPolicy(this->overflowPolicy);
+        printf("Policy OK! -> Drop oldest\n");
+    } else if (command == "policy lossless") {
+        this->overflowPolicy = OverflowPolicy::Lossless;
+        this->logic->SetOverflowPolicy(this->overflowPolicy);
+        printf("Policy OK! -> Lossless\n");
+    } else if (command == "pingpong on" || command == "pingpong off") {
+        // Applies from the next reader, so no need to stop the current one
+        const bool enabled = (command == "pingpong on");
+        this->logic->SetPingPong(enabled);
+        printf("Ping-pong OK! -> %s from next reader\n", enabled ? "Two SMs" : "Single SM");
+    } else if (command == "coalesce on" || command == "coalesce off") {
+        const bool enabled = (command == "coalesce on");
+        this->logic->SetCoalescing(enabled);
+        printf("Coalesce OK! -> %s\n", enabled ? "Repeated writes folded" : "Every write queued");
+    } else if (command == "engine dma") {
+        this->dumpEngine = Logic::CaptureEngine::Dma;
+        printf("Engine OK! -> Bus dump through DMA from next reader\n");
+    } else if (command == "engine poll") {
+        this->dumpEngine = Logic::CaptureEngine::Polled;
+        printf("Engine OK! -> Bus dump polled by core 1 from next reader\n");
+    } else if (command == "engine irq") {
+        this->dumpEngine = Logic::CaptureEngine::Interrupt;
+        printf("Engine OK! -> Bus dump through PIO IRQ from next reader\n");
+    } else if (command.starts_with("trigger ")) {
+        // trigger <spec>: see TriggerEngine::Parse. "trigger off" disables it.
+        const auto spec = command.substr(8);
+        if (this->ReaderActive()) {
+            printf("Trigger KO! -> Stop the reader first\n");
+        } else if (spec == "off") {
+            this->triggerConfig.Clear();
+            this->logic->SetTrigger(this->triggerConfig, this->triggerPost);
+            printf("Trigger OK! -> Off\n");
+        } else if (this->triggerConfig.Parse(spec)) {
+            this->logic->SetTrigger(this->triggerConfig, this->triggerPost);
+            printf("Trigger OK! -> %u before, %u after\n",
+                static_cast<unsigned int>(this->triggerPre), static_cast<unsigned int>(this->triggerPost));
+        } else {
+            printf("Trigger KO! -> Expected something like 80=2B,reset\n");
+        }
+    } else if (command.starts_with("window ")) {
+        // window <pre> <post>: events to keep around the trigger, in decimal
+        unsigned int pre = 0;
+        unsigned int post = 0;
+        const std::string args { command.substr(7) };
+        if (this->ReaderActive()) {
+            printf("Window KO! -> Stop the reader first\n");
+        } else if (sscanf(args.c_str(), "%u %u", &pre, &post) == 2 && pre + post + c_keepBacklog <= QUEUE_DEPTH) {
+            this->triggerPre = pre;
+            this->triggerPost = post;
+            this->logic->SetTrigger(this->triggerConfig, this->triggerPost);
+            printf("Window OK! -> %u before, %u after\n", pre, post);
+        } else {
+            printf("Window KO! -> Up to %u events in total\n", static_cast<unsigned int>(QUEUE_DEPTH - c_keepBacklog));
+        }
+    } else if (command == "timing") {
+        this->PrintCycleStats();
+    } else if (command == "profile") {
+        if (this->app_currentSelect == ProgramSelect::StageProfiler) {
+            this->ui->PrintProfile();
+        } else {
+            printf("Profile KO! -> Start stage timing first\n");
+        }
+    } else if (command == "golden") {
+        this->ui->PrintGolden();
+    } else if (command == "golden record") {
+        // Takes over at the next reset deassertion, in the Golden boot mode
+        this->ui->GetGolden().Arm();
+        this->ui->RefreshGolden();
+    } else if (command == "golden stop") {
+        if (this->ui->GetGolden().Stop()) {
+            this->ui->RefreshGolden();
+        } else {
+            printf("Golden KO! -> Not recording\n");
+        }
+    } else if (command.starts_with("golden tol ")) {
+        // golden tol <percent> <ms>: how much slower than the reference each stage can be
+        unsigned int pct = 0;
+        unsigned int slackMs = 0;
+        const std::string args { command.substr(11) };
+        if (sscanf(args.c_str(), "%u %u", &pct, &slackMs) == 2 && pct <= 1000 && slackMs <= 60000) {
+            this->ui->GetGolden().SetTolerance(pct, slackMs * 1000);
+            printf("Golden OK! -> Stages up to %u%% slower, plus %u ms\n", pct, slackMs);
+        } else {
+            printf("Golden KO! -> Expected something like golden tol 25 50\n");
+        }
+    } else if (command == "cdb") {
+        const BiosVendor vendor = this->ui->GetCodeDatabase();
+        printf("POST code database v%u -> %u entries | Using %s", PROJ_CDB_VER,
+            static_cast<unsigned int>(PostCodeDatabase::Count()), PostCodeDatabase::VendorName(vendor));
+        if (vendor != BiosVendor::None) {
+            printf(", %u entries", static_cast<unsigned int>(PostCodeDatabase::Count(vendor)));
+        }
+        printf("\nPOST code database -> %s\n", CdbVendorList().c_str());
+    } else if (command.starts_with("cdb ")) {
+        // cdb <vendor>: any vendor with entries in the tables, or off
+        BiosVendor vendor = BiosVendor::None;
+        if (PostCodeDatabase::ParseVendor(command.substr(4), vendor)) {
+            this->ui->SetCodeDatabase(vendor);
+            printf("CDB OK! -> %s, %u entries\n", PostCodeDatabase::VendorName(vendor),
+                static_cast<unsigned int>(PostCodeDatabase::Count(vendor)));
+        } else {
+            printf("CDB KO! -> Expected one of %s\n", CdbVendorList().c_str());
+        }
+    } else if (command == "log") {
+        if (this->app_currentSelect == ProgramSelect::DeepCapture) {
+            printf("Log KO! -> Stop deep capture first\n");
+        } else {
+            this->PrintDeepLog();
+        }
+    } else if (command.starts_with("log ")) {
+        // log <session>: plays a recorded boot back, log erase: wipes them all
+        unsigned int session = 0;
+        const std::string args { command.substr(4) };
+        if (this->ReaderActive()) {
+            printf("Log KO! -> Stop the reader first\n");
+        } else if (args == "erase") {
+            this->logic->GetDeepLog().Wipe();
+            printf("Log OK! -> Erased\n");
+        } else if (sscanf(args.c_str(), "%u", &session) == 1) {
+            this->ReplayDeepLog(session);
+        } else {
+            printf("Log KO! -> Expected a session number, or erase\n");
+        }
+    } else if (command == "ports") {
+        this->PrintInventory();
+    } else if (command == "stats") {
+        this->PrintLosses();
+        const auto timing = this->logic->GetBusTiming();
+        printf("Timing -> PIO clkdiv %u.%02u | Mux delay %u | Dead time %u ns\n",
+            static_cast<unsigned int>(timing.clkDiv256 >> 8), static_cast<unsigned int>((timing.clkDiv256 & 0xFF) * 100 / 256),
+            static_cast<unsigned int>(timing.muxDelay), static_cast<unsigned int>(timing.DeadTimeNs(REQ_CLOCK_KHZ)));
+    } else {
+        printf("Unknown command\n");
+    }
+}
+
+bool Application::ReaderActive() const
+{
+    switch (this->app_currentSelect) {
+    case ProgramSelect::Port80Reader:
+    case ProgramSelect::Port90Reader:
+    case ProgramSelect::Port84Reader:
+    case ProgramSelect::Port300Reader:
+    case ProgramSelect::Port378Reader:
+    case ProgramSelect::MultiPortReader:
+    case ProgramSelect::CustomReader:
+    case ProgramSelect::WordReader:
+    case ProgramSelect::ConsoleReader:
+    case ProgramSelect::BeepReader:
+    case ProgramSelect::StageProfiler:
+    case ProgramSelect::GoldenMatch:
+    case ProgramSelect::BiosDetect:
+    case ProgramSelect::DeepCapture:
+    case ProgramSelect::BusDump:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+void Application::PrintLosses()
+{
+    const auto losses = this->logic->GetLosses();
+    printf("Losses -> PIO stalls %u | DMA %u | Ring %u | UI %u\n",
+        static_cast<unsigned int>(losses.pioStalls), static_cast<unsigned int>(losses.captureBuffer),
+        static_cast<unsigned int>(losses.eventRing), static_cast<unsigned int>(this->displayDropped));
+}
+
+void Application::PrintDeepLog()
+{
+    auto& log = this->logic->GetDeepLog();
+    if (!log.Mount()) {
+        printf("Log KO! -> No room for it in flash\n");
+        return;
+    }
+
+    // Usage and wear first, then one line per session, oldest first
+    const auto stats = log.GetStats();
+    printf("Log -> %u of %u blocks used | %u sectors erased ahead | Erased %u to %u times | "
+           "Last run: %u dropped, %u erase stalls\n",
+        static_cast<unsigned int>(stats.pagesUsed), static_cast<unsigned int>(stats.pagesTotal),
+        static_cast<unsigned int>(stats.reserve), static_cast<unsigned int>(stats.minErases),
+        static_cast<unsigned int>(stats.maxErases), static_cast<unsigned int>(stats.dropped),
+        static_cast<unsigned int>(stats.forcedErases));
+    log.ForEachSession([](const Logic::DeepLog::Session& session) {
+        printf("Session %u -> %u events | %u bytes | %.3f s%s\n", static_cast<unsigned int>(session.id),
+            static_cast<unsigned int>(session.events), static_cast<unsigned int>(session.bytes),
+            CaptureClock::ToMicros(session.ticks) / 1000000.0, session.truncated ? " | Oldest events overwritten" : "");
+    });
+}
+
+void Application::ReplayDeepLog(uint32_t session)
+{
+    auto& log = this->logic->GetDeepLog();
+    if (!log.Mount()) {
+        printf("Log KO! -> No room for it in flash\n");
+        return;
+    }
+
+    // Played back as plain POST codes, whatever reader ran last
+    this->ui->SetLanes(false);
+    this->ui->SetWords(false, this->wordConfig);
+    this->ui->SetConsole(false);
+    this->ui->SetBeeps(false);
+    this->ui->SetProfiler(false);
+    this->ui->SetGolden(false);
+    this->ui->SetFingerprint(false);
+    this->ui->ClearBuffers();
+
+    std::vector<BusEvent> events {};
+    events.reserve(c_replayChunk);
+    const bool found = log.Replay(session, [this, &events](const BusEvent& event) {
+        events.push_back(event);
+        if (events.size() == c_replayChunk) {
+            this->ui->NewData(events.data(), events.size(), false);
+            events.clear();
+        }
+    });
+    if (!events.empty()) {
+        this->ui->NewData(events.data(), events.size(), false);
+    }
+    this->ui->ClearBuffers();
+
+    if (found) {
+        printf("Log OK! -> Session %u replayed\n", static_cast<unsigned int>(session));
+    } else {
+        printf("Log KO! -> No session %u, try log\n", static_cast<unsigned int>(session));
+    }
+}
+
+void Application::PrintCycleStats()
+{
+    // One line per port: count, width range and mean, then both histograms
+    this->logic->GetCycleStats(this->cycleStats);
+    printf("IO timing -> %u cycles | %u PIO stalls | Width bins %u ns | Gap bins double from %u ns\n",
+        static_cast<unsigned int>(this->cycleStats.Total()), static_cast<unsigned int>(this->cycleStats.Stalls()),
+        static_cast<unsigned int>(CycleStats::c_widthBinNs), static_cast<unsigned int>(CycleStats::c_gapBaseNs));
+
+    auto printPort = [](const char* label, const CycleStats::Port& port) {
+        if (port.cycles == 0) {
+            return;
+        }
+        printf("%5s | %8u | Width %u-%u ns, avg %u | W", label, static_cast<unsigned int>(port.cycles),
+            static_cast<unsigned int>(port.widthMinNs), static_cast<unsigned int>(port.widthMaxNs),
+            static_cast<unsigned int>(port.widthSumNs / port.cycles));
+        for (const auto count : port.widthBins) {
+            printf(" %u", static_cast<unsigned int>(count));
+        }
+        printf(" | G");
+        for (const auto count : port.gapBins) {
+            printf(" %u", static_cast<unsigned int>(count));
+        }
+        printf("\n");
+    };
+
+    char label[8];
+    for (const auto& port : this->cycleStats.Ports()) {
+        sprintf(label, "%04Xh", port.address);
+        printPort(label, port);
+    }
+    printPort("Other", this->cycleStats.Others());
+}
+
+void Application::PrintInventory()
+{
+    // Every port seen by the port heatmap, ISA range first
+    this->logic->GetHeatmap(this->heatmap);
+    printf("Inventory -> %u writes | %u uncounted | %u PIO stalls\n",
+        static_cast<unsigned int>(this->heatmap.Total()), static_cast<unsigned int>(this->heatmap.Spilled()),
+        static_cast<unsigned int>(this->heatmap.Stalls()));
+    this->heatmap.ForEach([](uint16_t address, uint32_t count) {
+        const char* name = PortHeatmap::DeviceName(address);
+        printf("%04Xh %-5s | %10u\n", address, (name != nullptr) ? name : "?", static_cast<unsigned int>(count));
+    });
+}
+
 __attribute__((noreturn)) void Application::BlinkenHalt(ErrorCodes blinks)
 {
     while (true) {
@@ -441,8 +977,10 @@ Application::Application()
     // unresponsive. Delay everything by some arbitrary amount of time
     sleep_ms(75);
 
-    // Initialize data queue for async, multi-threaded data output
-    queue_init(&this->dataQueue, sizeof(QueueData), QUEUE_DEPTH);
+    // Initialize voltage and clock queues for async, multi-threaded data output.
+    // Bus events have their own lock-free ring instead.
+    queue_init(&this->voltsQueue, sizeof(VoltageSample), c_voltsQueueDepth);
+    queue_init(&this->clockQueue, sizeof(ClockSample), c_clockQueueDepth);
 
     // Onboard LED shows if we're ready for operation
     // Start off, turn back on when we're ready to enter main loop
@@ -534,6 +1072,8 @@ Application::Application()
         }
     }
 
+    this->customFilter.Add(0x80);
+
     this->logic = std::make_unique<Logic>();
 
     gpio_put(PICO_DEFAULT_LED_PIN, true);
@@ -9,6 +9,7 @@
 #include <memory>
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 // Accessory libs
 #include "gpioexp.hpp"
@@ -115,6 +116,16 @@ private:
     // 20ms debounce, see https://www.eejournal.com/article/ultimate-guide-to-switch-debounce-part-4/
     static const uint64_t c_debounceRate { 20000 };
     static const size_t c_maxStrbuff { 14 };
+    static const uint c_voltsQueueDepth { 16 };
+    static const uint c_clockQueueDepth { 16 };
+    static const size_t c_maxCommandLength { 64 };
+    static const uint64_t c_heatmapPeriod { 1000000 };
+    static const size_t c_heatmapTop { 8 };
+    static const size_t c_replayChunk { 64 };
+    // Backlog levels, in events, for OverflowPolicy handling
+    static const size_t c_trimBacklog { QUEUE_DEPTH * 3 / 4 };
+    static const size_t c_keepBacklog { 256 };
+    static const size_t c_throttleBacklog { QUEUE_DEPTH / 2 };
 
     static const uint64_t c_standbyTimer { PICOPOST_STANDBY_TIMER * 1000000 };    
     static const uint8_t c_minBrightness { 0x09 };
@@ -128,14 +139,37 @@ private:
     void Keystroke();
     void UserOutput();
     void StandbyTick();
+    void PollSerialCommand();
+    void RunSerialCommand(std::string_view command);
+    void PrintLosses();
+    void PrintCycleStats();
+    void PrintInventory();
+    void PrintDeepLog();
+    void ReplayDeepLog(uint32_t session);
+    bool ReaderActive() const;
 
     std::unique_ptr<Logic> logic { nullptr };
 
     KeyboardState keyboard {};
     TextScroll textScroll {};
+    std::string serialCommand {};
     
     UserMode hwMode { UserMode::Invalid };
-    queue_t dataQueue;
+    Logic::EventRing dataRing {};
+    PortFilter customFilter {};
+    WordAssembler wordConfig {};
+    OverflowPolicy overflowPolicy { OverflowPolicy::Lossless };
+    std::atomic<Logic::CaptureEngine> dumpEngine { Logic::CaptureEngine::Dma };
+    uint32_t displayDropped { 0 };
+    TriggerEngine triggerConfig {};
+    uint32_t triggerPre { 1024 };
+    uint32_t triggerPost { 1024 };
+    Logic::TriggerState lastTrigger { Logic::TriggerState::Off };
+    CycleStats cycleStats {};
+    PortHeatmap heatmap {};
+    uint64_t heatmapTick { 0 };
+    queue_t voltsQueue;
+    queue_t clockQueue;
     UserInterface* ui { nullptr };
 
     int app_currentMenuIdx { 0 };
@@ -0,0 +1,245 @@
+/**
+ * @file beeps.hpp
+ * @brief Rebuilds BIOS beep codes from PIT channel 2 and port 61h writes.
+ *
+ */
+
+#ifndef PICOPOST_BEEPS_HPP
+#define PICOPOST_BEEPS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief Follows the PC speaker the way the BIOS drives it, and tells which
+ * beep code it played.
+ *
+ * @par
+ * The tone comes from PIT channel 2: control words on 43h pick how its divisor
+ * is written, the divisor itself goes through 42h. The speaker sounds while
+ * both the gate and the data enable bits in port 61h are set. All of these
+ * are IO writes, so each beep's pitch, length and the silence before it can be
+ * told from capture timestamps, to the microsecond.
+ *
+ * @par
+ * Beeps closer than c_patternEndUs to each other make up a pattern, which is
+ * handed out through emit(const Pattern&) once the speaker stays quiet for
+ * that long, or on Flush(). Lengths are classified as short or long relative
+ * to each other, with an absolute threshold when they are all alike, and
+ * Describe() names the pattern AMI/Award style ("1 long 3 short") or, when the
+ * silences come in two sizes, Phoenix style ("1-2-2-3").
+ */
+class BeepDecoder {
+public:
+    static constexpr uint16_t c_pitCounter2 { 0x42 };
+    static constexpr uint16_t c_pitControl { 0x43 };
+    static constexpr uint16_t c_speakerPort { 0x61 };
+    static constexpr size_t c_maxBeeps { 16 };
+    static constexpr uint64_t c_patternEndUs { 1500000 };
+    static constexpr uint64_t c_longBeepUs { 600000 }; // When all beeps are alike
+    static constexpr uint32_t c_pitClockHz { 1193182 };
+
+    struct Beep {
+        uint32_t lengthUs { 0 };
+        uint32_t gapUs { 0 }; // Silence before this beep, zero for the first one
+        uint32_t frequencyHz { 0 };
+    };
+
+    struct Pattern {
+        Beep beeps[c_maxBeeps] {};
+        size_t count { 0 };
+        bool truncated { false }; // More beeps than c_maxBeeps, only the first ones are here
+    };
+
+    bool Matches(uint16_t port) const
+    {
+        return port == c_pitCounter2 || port == c_pitControl || port == c_speakerPort;
+    }
+
+    // Back to power-on state, a pattern in progress is thrown away
+    void Reset()
+    {
+        pattern = {};
+        divisor = 0;
+        accessMode = AM_LsbMsb;
+        msbNext = false;
+        sounding = false;
+        startedAt = 0;
+        endedAt = 0;
+    }
+
+    // True while the speaker is on
+    bool Sounding() const
+    {
+        return sounding;
+    }
+
+    uint32_t FrequencyHz() const
+    {
+        return c_pitClockHz / (divisor == 0 ? 0x10000 : divisor);
+    }
+
+    /**
+     * @brief Adds a write to one of the speaker ports.
+     *
+     * @param atUs Capture time of the write, in us
+     */
+    template <typename Emit>
+    void Feed(uint64_t atUs, uint16_t port, uint8_t data, Emit&& emit)
+    {
+        Expire(atUs, emit);
+
+        switch (port) {
+        case c_pitControl: {
+            // Only channel 2 counter loads matter, latch and read-back commands don't change the tone
+            const uint8_t mode = (data >> 4) & 0x03;
+            if ((data >> 6) == 2 && mode != AM_Latch) {
+                accessMode = static_cast<AccessMode>(mode);
+                msbNext = (accessMode == AM_Msb);
+            }
+        } break;
+
+        case c_pitCounter2: {
+            if (msbNext) {
+                divisor = static_cast<uint16_t>((divisor & 0x00FF) | (data << 8));
+            } else {
+                divisor = (divisor & 0xFF00) | data;
+            }
+            if (accessMode == AM_LsbMsb) {
+                msbNext = !msbNext;
+            }
+        } break;
+
+        case c_speakerPort: {
+            const bool on = (data & 0x03) == 0x03;
+            if (on && !sounding) {
+                startedAt = atUs;
+            } else if (!on && sounding) {
+                AddBeep(atUs);
+            }
+            sounding = on;
+        } break;
+        }
+    }
+
+    // Closes the pattern if the speaker has been quiet long enough by atUs
+    template <typename Emit>
+    void Expire(uint64_t atUs, Emit&& emit)
+    {
+        if (!sounding && pattern.count > 0 && atUs - endedAt >= c_patternEndUs) {
+            Flush(emit);
+        }
+    }
+
+    // Hands out the pattern so far, if any. A beep still sounding is left alone.
+    template <typename Emit>
+    void Flush(Emit&& emit)
+    {
+        if (pattern.count > 0) {
+            emit(pattern);
+            pattern = {};
+        }
+    }
+
+    /**
+     * @brief Names a pattern, e.g. "1 long 3 short" or "1-2-2-3".
+     *
+     * @return Same as snprintf, output is always terminated
+     */
+    static int Describe(const Pattern& pattern, char* out, size_t size)
+    {
+        if (size == 0) {
+            return 0;
+        }
+        out[0] = '\0';
+        if (pattern.count == 0) {
+            return 0;
+        }
+
+        uint32_t minLength = UINT32_MAX;
+        uint32_t maxLength = 0;
+        uint32_t minGap = UINT32_MAX;
+        uint32_t maxGap = 0;
+        for (size_t idx = 0; idx < pattern.count; idx++) {
+            minLength = std::min(minLength, pattern.beeps[idx].lengthUs);
+            maxLength = std::max(maxLength, pattern.beeps[idx].lengthUs);
+            if (idx > 0) {
+                minGap = std::min(minGap, pattern.beeps[idx].gapUs);
+                maxGap = std::max(maxGap, pattern.beeps[idx].gapUs);
+            }
+        }
+
+        int written = 0;
+        auto append = [&](const char* fmt, auto... args) {
+            const size_t used = std::min<size_t>(written, size - 1);
+            written += snprintf(out + used, size - used, fmt, args...);
+        };
+
+        if (pattern.count > 2 && maxGap >= 2 * minGap) {
+            // Phoenix style, beeps grouped by the longer silences
+            const uint32_t split = (minGap + maxGap) / 2;
+            unsigned int group = 1;
+            for (size_t idx = 1; idx < pattern.count; idx++) {
+                if (pattern.beeps[idx].gapUs > split) {
+                    append("%u-", group);
+                    group = 0;
+                }
+                group++;
+            }
+            append("%u", group);
+        } else {
+            // AMI/Award style, runs of long and short beeps
+            const uint32_t longFrom = (maxLength >= 2 * minLength) ? (minLength + maxLength) / 2 : c_longBeepUs;
+            size_t idx = 0;
+            while (idx < pattern.count) {
+                const bool isLong = pattern.beeps[idx].lengthUs >= longFrom;
+                unsigned int run = 0;
+                while (idx < pattern.count && (pattern.beeps[idx].lengthUs >= longFrom) == isLong) {
+                    run++;
+                    idx++;
+                }
+                append((written > 0) ? " %u %s" : "%u %s", run, isLong ? "long" : "short");
+            }
+        }
+        if (pattern.truncated) {
+            append("+");
+        }
+        return written;
+    }
+
+private:
+    // PIT control word, bits 5-4
+    enum AccessMode : uint8_t {
+        AM_Latch = 0,
+        AM_Lsb = 1,
+        AM_Msb = 2,
+        AM_LsbMsb = 3,
+    };
+
+    Pattern pattern {};
+    uint16_t divisor { 0 };
+    AccessMode accessMode { AM_LsbMsb };
+    bool msbNext { false };
+    bool sounding { false };
+    uint64_t startedAt { 0 };
+    uint64_t endedAt { 0 };
+
+    void AddBeep(uint64_t atUs)
+    {
+        if (pattern.count == c_maxBeeps) {
+            pattern.truncated = true;
+        } else {
+            pattern.beeps[pattern.count] = {
+                .lengthUs = static_cast<uint32_t>(std::min<uint64_t>(atUs - startedAt, UINT32_MAX)),
+                .gapUs = (pattern.count == 0) ? 0 : static_cast<uint32_t>(std::min<uint64_t>(startedAt - endedAt, UINT32_MAX)),
+                .frequencyHz = FrequencyHz(),
+            };
+            pattern.count++;
+        }
+        endedAt = atUs;
+    }
+};
+
+#endif // PICOPOST_BEEPS_HPP
@@ -0,0 +1,172 @@
+/**
+ * @file blockring.hpp
+ * @brief Ring of fixed-size blocks, filled by DMA and drained in place by the
+ * capture loop.
+ *
+ */
+
+#ifndef PICOPOST_BLOCKRING_HPP
+#define PICOPOST_BLOCKRING_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief Single producer, single consumer ring of fixed-size blocks.
+ *
+ * @par
+ * The producer (a DMA completion handler) reserves blocks with Arm() and hands
+ * them to a DMA channel, then publishes them with Complete() once the transfer
+ * is done. Blocks always finish in the same order they were armed, so a simple
+ * counter is enough to keep track of completed blocks.
+ *
+ * @par
+ * The consumer reads the oldest block in place with Peek() and gives words
+ * back with Release(). It may also peek into the block currently being
+ * written, as long as it is told how many words already landed there. This
+ * keeps latency low when the bus is quiet and a block takes ages to fill up.
+ *
+ * @par
+ * Words the producer had to throw away are reported with Lose(), and stick to
+ * the position they were lost at: the consumer gets them back from TakeLost()
+ * when it starts on the block that follows, not any earlier.
+ *
+ * @par
+ * Nothing in here touches the hardware, so the hand-off logic can be built and
+ * exercised on a host machine against a simulated FIFO.
+ */
+template <typename T, size_t BlockSize, size_t BlockCount>
+class BlockRing {
+    static_assert((BlockCount & (BlockCount - 1)) == 0, "BlockCount must be a power of 2");
+    static_assert(BlockCount >= 2, "At least two blocks are needed for ping-pong transfers");
+
+public:
+    static constexpr size_t c_blockSize { BlockSize };
+    // Losses are only recorded right before a block in flight, so there's never more than BlockCount + 1 pending
+    static constexpr size_t c_lossSlots { BlockCount * 2 };
+
+    // Producer: reserve the next free block. Returns nullptr if the consumer is too far behind.
+    T* Arm()
+    {
+        const size_t currReadHead = readHead.load(std::memory_order_acquire);
+        if (armHead - currReadHead >= BlockCount) {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* block = blocks[armHead & (BlockCount - 1)].data();
+        armHead++;
+        return block;
+    }
+
+    // Producer: sequence number of the most recently armed block.
+    size_t LastArmed() const
+    {
+        return armHead - 1;
+    }
+
+    // Producer: the oldest armed block has been fully written.
+    void Complete()
+    {
+        doneHead.store(doneHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Producer: words lost right before the oldest block still being written, which is already armed.
+    void Lose(uint32_t words)
+    {
+        const size_t tail = lossTail.load(std::memory_order_relaxed);
+        if (tail - lossHead.load(std::memory_order_acquire) >= c_lossSlots) {
+            return;
+        }
+
+        losses[tail & (c_lossSlots - 1)] = { doneHead.load(std::memory_order_relaxed), words };
+        lossTail.store(tail + 1, std::memory_order_release);
+    }
+
+    // Consumer: sequence number of the oldest block still being written.
+    size_t Completed() const
+    {
+        return doneHead.load(std::memory_order_acquire);
+    }
+
+    // Consumer: readable words of the oldest block. `landed` tells how far the in-flight block got.
+    std::span<const T> Peek(size_t landed = 0) const
+    {
+        const size_t currReadHead = readHead.load(std::memory_order_relaxed);
+        const size_t limit = (currReadHead != Completed()) ? BlockSize : std::min(landed, BlockSize);
+        if (limit <= readOffset) {
+            return {};
+        }
+
+        return { blocks[currReadHead & (BlockCount - 1)].data() + readOffset, limit - readOffset };
+    }
+
+    // Consumer: words lost right before the oldest block, once Peek() returned its first words. Zero past that.
+    uint32_t TakeLost()
+    {
+        if (readOffset != 0) {
+            return 0;
+        }
+
+        const size_t currReadHead = readHead.load(std::memory_order_relaxed);
+        const size_t tail = lossTail.load(std::memory_order_acquire);
+        size_t head = lossHead.load(std::memory_order_relaxed);
+        uint32_t words = 0;
+        while (head != tail && losses[head & (c_lossSlots - 1)].before <= currReadHead) {
+            words += losses[head & (c_lossSlots - 1)].words;
+            head++;
+        }
+        lossHead.store(head, std::memory_order_release);
+        return words;
+    }
+
+    // Consumer: give back words obtained from Peek()
+    void Release(size_t count)
+    {
+        readOffset += count;
+        if (readOffset >= BlockSize) {
+            readOffset = 0;
+            readHead.store(readHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    }
+
+    // Number of times the producer found no free block
+    uint32_t Overruns() const
+    {
+        return overruns.load(std::memory_order_relaxed);
+    }
+
+    // Only safe while no transfer is in flight
+    void Reset()
+    {
+        armHead = 0;
+        readOffset = 0;
+        doneHead.store(0, std::memory_order_relaxed);
+        readHead.store(0, std::memory_order_relaxed);
+        lossTail.store(0, std::memory_order_relaxed);
+        lossHead.store(0, std::memory_order_relaxed);
+        overruns.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct Loss {
+        size_t before; // Block sequence number
+        uint32_t words;
+    };
+
+    std::array<std::array<T, BlockSize>, BlockCount> blocks {};
+    size_t armHead { 0 }; // Producer only
+    size_t readOffset { 0 }; // Consumer only
+    std::atomic<size_t> doneHead { 0 }; // Producer (DMA IRQ)
+    std::atomic<size_t> readHead { 0 }; // Consumer (capture loop)
+    std::array<Loss, c_lossSlots> losses {};
+    std::atomic<size_t> lossTail { 0 }; // Producer
+    std::atomic<size_t> lossHead { 0 }; // Consumer
+    std::atomic<uint32_t> overruns { 0 };
+};
+
+#endif // PICOPOST_BLOCKRING_HPP
@@ -0,0 +1,68 @@
+/**
+ * @file bustiming.hpp
+ * @brief PIO sampling timings used by the bus readers.
+ *
+ */
+
+#ifndef PICOPOST_BUSTIMING_HPP
+#define PICOPOST_BUSTIMING_HPP
+
+#include "captureclock.hpp"
+
+#include <cstdint>
+
+/**
+ * @brief How fast the bus readers run, and how long they let the address
+ * mux settle after switching banks.
+ *
+ * @par
+ * Both programs sample the bus twice per cycle, swapping the address bank in
+ * between. The delays on the "capture" and "mux_wait" instructions give the
+ * mux time to settle, and they're patched into the program before it gets
+ * loaded, so they can be tuned at runtime along with the clock divider.
+ *
+ * @par
+ * Everything here is in PIO cycles, which only turn into nanoseconds through
+ * the divider. Calibration looks for the pair with the shortest dead time per
+ * bus cycle that still samples cleanly.
+ */
+struct BusTiming {
+    static constexpr uint8_t c_maxDelay { 7 }; // ".side_set 1 opt" leaves 3 bits of delay
+    static constexpr uint8_t c_maxMuxDelay { 2 * c_maxDelay };
+    static constexpr uint32_t c_captureCycles { 4 }; // Bus_FastRead sampling instructions, without delays
+    static constexpr uint32_t c_handoffCycles { 2 }; // Bus_PingPong, other SM picking up the turn
+
+    uint16_t clkDiv256 { 256 }; ///< PIO clock divider, 8.8 fixed point
+    uint8_t muxDelay { 8 }; ///< Delay cycles added after the bank switch. Keep it even.
+
+    // Split across the two instructions, the first one takes the odd cycle
+    constexpr uint8_t FirstDelay() const { return muxDelay - muxDelay / 2; }
+    constexpr uint8_t SecondDelay() const { return muxDelay / 2; }
+
+    // Bus_FastRead timestamp ticks (two PIO cycles) that go by while sampling,
+    // minus the one counted by the sampling code itself
+    constexpr uint32_t StallTicks() const { return (c_captureCycles + muxDelay) / 2 - 1; }
+
+    // Same for Bus_PingPong, where the turn changes hands before counting resumes
+    constexpr uint32_t PingPongStallTicks() const { return (c_captureCycles + c_handoffCycles + muxDelay) / 2; }
+
+    // Bus_FastRead timestamp tick, in CaptureClock units, Q16
+    constexpr uint32_t TickQ16(uint32_t sysKhz) const
+    {
+        return static_cast<uint32_t>(clkDiv256 * ((2ull << CaptureClock::c_fracBits) * 1000 * 65536 / 256) / sysKhz);
+    }
+
+    // PIO cycles, as run with this divider, to nanoseconds
+    constexpr uint32_t CyclesToNs(uint64_t cycles, uint32_t sysKhz) const
+    {
+        return static_cast<uint32_t>(cycles * clkDiv256 * 1000000ull / (256ull * sysKhz));
+    }
+
+    // Time spent sampling a single bus cycle, when the next one can't be seen
+    constexpr uint32_t DeadTimeNs(uint32_t sysKhz) const
+    {
+        return CyclesToNs(c_captureCycles + muxDelay, sysKhz);
+    }
+};
+
+#endif // PICOPOST_BUSTIMING_HPP
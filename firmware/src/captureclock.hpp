@@ -0,0 +1,119 @@
+/**
+ * @file captureclock.hpp
+ * @brief Turns raw capture timestamps back into absolute time.
+ *
+ */
+
+#ifndef PICOPOST_CAPTURECLOCK_HPP
+#define PICOPOST_CAPTURECLOCK_HPP
+
+#include <cstdint>
+
+/**
+ * @brief Rebuilds absolute time from the free-running PIO tick counter.
+ *
+ * @par
+ * Bus_FastRead keeps decrementing X once every two PIO cycles, and pushes it
+ * right after each sample. That gives a 32-bit timestamp with about 11 ns of
+ * resolution at 330 MHz, taken when the bus cycle happened rather than when
+ * the CPU got around to it. The counter wraps every ~47 seconds, and it stands
+ * still for a few ticks while a cycle is being sampled.
+ *
+ * @par
+ * Both quirks are dealt with here: the sampling stall is added back for each
+ * event, and wraps are tracked against the previous event. If the bus stays
+ * quiet for longer than a whole counter period, the CPU timer tells how many
+ * wraps went by unseen.
+ *
+ * @par
+ * Resolved time is expressed in 1/16 us units (62.5 ns) since boot, so it can
+ * be turned into microseconds with a shift instead of a 64-bit division.
+ */
+class CaptureClock {
+public:
+    static constexpr uint32_t c_fracBits { 4 };
+
+    static constexpr uint64_t FromMicros(uint64_t us) { return us << c_fracBits; }
+    static constexpr uint64_t ToMicros(uint64_t t) { return t >> c_fracBits; }
+
+    /**
+     * @brief Rebuilds a full microsecond timestamp from its lower 32 bits.
+     * Only valid if the stamp is less than ~71 minutes old.
+     */
+    static constexpr uint64_t ExpandMicros(uint32_t stampUs, uint64_t nowUs)
+    {
+        return nowUs - static_cast<uint32_t>(static_cast<uint32_t>(nowUs) - stampUs);
+    }
+
+    /**
+     * @brief Anchors the PIO counter to the CPU timer. Call right before
+     * enabling the SM, with X set to zero.
+     *
+     * @param startUs CPU time at which the counter started from zero
+     * @param tickQ16 Duration of a PIO tick, in 1/16 us units, Q16 fixed point
+     * @param stallTicks Ticks lost by the PIO while sampling a single cycle
+     */
+    void Start(uint64_t startUs, uint32_t tickQ16, uint32_t stallTicks)
+    {
+        m_start = FromMicros(startUs);
+        m_tickQ16 = tickQ16;
+        m_stallTicks = stallTicks;
+        m_stallTotal = 0;
+        m_lastTicks = 0;
+        m_lastUs = startUs;
+        m_periodUs = ToMicros((c_period * tickQ16) >> 16);
+    }
+
+    /**
+     * @brief Converts a raw PIO stamp. Stamps must be fed in capture order.
+     *
+     * @param stamp Raw X register value pushed by the PIO
+     * @param nowUs Current CPU time, only used after long silences
+     * @return Capture time, in 1/16 us units since boot
+     */
+    uint64_t Resolve(uint32_t stamp, uint64_t nowUs)
+    {
+        // X counts down from zero
+        uint64_t ticks = (m_lastTicks & ~(c_period - 1)) | static_cast<uint32_t>(0u - stamp);
+        if (ticks < m_lastTicks) {
+            ticks += c_period;
+        }
+
+        // Quiet bus, the counter may have wrapped a few times since last event
+        if (nowUs - m_lastUs >= m_periodUs) {
+            const uint64_t hostTicks = (FromMicros(nowUs) - m_start) * 65536 / m_tickQ16;
+            while (ticks + m_stallTotal + c_period <= hostTicks) {
+                ticks += c_period;
+            }
+        }
+
+        m_lastTicks = ticks;
+        const uint64_t resolved = m_start + (((ticks + m_stallTotal) * m_tickQ16) >> 16);
+        m_stallTotal += m_stallTicks;
+        m_lastUs = ToMicros(resolved);
+
+        return resolved;
+    }
+
+    /**
+     * @brief Accounts for events that were lost before reaching Resolve(),
+     * so their sampling stall is still added back.
+     */
+    void Skip(uint32_t events)
+    {
+        m_stallTotal += static_cast<uint64_t>(events) * m_stallTicks;
+    }
+
+private:
+    static constexpr uint64_t c_period { 1ull << 32 };
+
+    uint64_t m_start { 0 };
+    uint64_t m_lastTicks { 0 };
+    uint64_t m_stallTotal { 0 };
+    uint64_t m_lastUs { 0 };
+    uint64_t m_periodUs { 0 };
+    uint32_t m_tickQ16 { 1 };
+    uint32_t m_stallTicks { 0 };
+};
+
+#endif // PICOPOST_CAPTURECLOCK_HPP
@@ -7,6 +7,8 @@ static const uint16_t c_maxBmpPayload { 1024 };
 static const uint8_t c_ui_iconSize { 8 };
 static const uint8_t c_ui_yIconAlign { 127 - c_ui_iconSize };
 static const uint8_t c_maxFrames { 10 };
+static const uint32_t c_maxPulseWidth { 0xFFFFFF }; ///< Longest reset pulse P80ResetCleared can tell, in us
+static const uint8_t c_calibNoTraffic { 0xFF }; ///< CalibrationStep data, when the bus was too quiet to tell
 
 enum Key {
     KE_None = 0x00,
@@ -27,8 +29,21 @@ enum class ProgramSelect {
     Port84Reader, ///< Early Compaq outputs to 84h
     Port300Reader, ///< Some EISA systems output to 300h
     Port378Reader, ///< Olivettis output to 378h. Can we capture LPT?
+    MultiPortReader, ///< Both 80h and 84h at once, for boards that can't make up their mind
+    CustomReader, ///< Any set of ports, configured over USB with the "filter" command
+    WordReader, ///< Two adjacent ports paired into 16-bit codes, configured over USB with the "word" command
+    ConsoleReader, ///< COM1, E9h and CMOS writes decoded into text
+    BeepReader, ///< Port 80h along with beep codes, rebuilt from PIT and speaker writes
+    StageProfiler, ///< Port 80h, timing how long each POST code stays on
+    GoldenMatch, ///< Port 80h, checking each boot against a known-good one
+    BiosDetect, ///< All POST ports, telling which BIOS is booting from its first codes
+    DeepCapture, ///< Port 80h, every boot also recorded to flash, listed and played back over USB
     BusDump, ///< Output all IO writes
+    CycleTiming, ///< Builds per-port IO cycle timing histograms
+    PortHeatmap, ///< Counts writes per port, shows the busiest ones and what's behind them
     VoltageMonitor, ///< Monitors the 5V and 12V rails
+    BusClock, ///< Measures BCLK frequency and jitter, rev 6 only
+    Calibration, ///< Looks for the fastest PIO timings the bus can be read with
 
     Info,
     UpdateFW,
@@ -41,18 +56,77 @@ enum class QueueOperation : uint8_t {
 
     P80Data,
     P80ResetActive,
-    P80ResetCleared,
-    Volts,
+    P80ResetCleared, ///< Address holds the pulse width in us, data its top byte (saturated)
+    P80Gap, ///< Events were lost here. Address holds how many (saturated), data holds LossStage bits
+    P80Trigger, ///< Trigger fired on the event right before this one
+    P80Repeat, ///< Last P80Data happened again, address times more (saturated), the last one at this event's time
+    CalibrationStep, ///< Address holds the dead time tried, in ns, data the torn samples (saturated) or c_calibNoTraffic
+    CalibrationDone, ///< Address holds the dead time picked, in ns, zero if nothing worked
 };
 
-struct __attribute__((packed)) QueueData {
-    uint64_t timestamp { 0 };
-    float volts5 { 0.f };
-    float volts12 { 0.f };
+/**
+ * @brief Where along the capture path events got lost, as reported in gap markers.
+ *
+ */
+enum LossStage : uint8_t {
+    LS_None = 0x00,
+
+    LS_PioStall = 0x01, ///< PIO RX FIFO was full, the SM stalled and missed bus cycles
+    LS_CaptureBuffer = 0x02, ///< DMA found no free block and threw one away
+    LS_EventRing = 0x04, ///< Ring to the UI core was full
+    LS_Display = 0x08, ///< UI core skipped a backlog to keep up (OverflowPolicy::DropOldest)
+    LS_FlashLog = 0x10, ///< Flash log had no room left in RAM, only in replayed sessions
+};
+
+/**
+ * @brief What to do when the UI can't keep up with the bus.
+ *
+ */
+enum class OverflowPolicy : uint8_t {
+    DropNewest, ///< Newly captured events are thrown away until there's room again
+    DropOldest, ///< UI skips the oldest events in its backlog, to stay close to real time
+    Lossless, ///< Capture waits for the UI, which stops refreshing the OLED until it catches up
+};
+
+/**
+ * @brief A single bus event, as sent from the capture core to the UI.
+ *
+ * @par
+ * Kept down to 8 bytes, so the data queue can hold lots of them. Time is not
+ * absolute: each event carries the time elapsed since the previous one, in
+ * 1/16 us units, and the receiving side adds them up.
+ *
+ */
+struct BusEvent {
+    static constexpr uint32_t c_maxDelta { UINT32_MAX };
+
+    uint32_t delta { 0 };
     uint16_t address { 0 };
     uint8_t data { 0 };
     QueueOperation operation { QueueOperation::None };
 };
+static_assert(sizeof(BusEvent) == 8, "BusEvent must stay compact");
+
+/**
+ * @brief A supply rails reading, sent by the voltage monitor on its own queue.
+ *
+ */
+struct VoltageSample {
+    uint64_t timestamp { 0 };
+    float volts5 { 0.f };
+    float volts12 { 0.f };
+};
+
+/**
+ * @brief A bus clock reading, sent by the clock meter on its own queue.
+ *
+ */
+struct ClockSample {
+    uint64_t timestamp { 0 };
+    uint32_t frequencyHz { 0 }; ///< Zero when BCLK isn't running
+    uint16_t minPeriodNs { 0 }; ///< Shortest single period seen since the previous sample
+    uint16_t maxPeriodNs { 0 }; ///< Longest one
+};
 
 using Bitmap = uint8_t[c_maxBmpPayload];
 
@@ -0,0 +1,227 @@
+/**
+ * @file console.hpp
+ * @brief Rebuilds text and register writes from the usual BIOS debug outputs.
+ *
+ */
+
+#ifndef PICOPOST_CONSOLE_HPP
+#define PICOPOST_CONSOLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief Streaming decoders for COM1, the E9h debug port and CMOS 70h/71h.
+ *
+ * @par
+ * Fed one IO write at a time, in bus order, it follows just enough of each
+ * device to tell what the writes mean:
+ * - 8250/16550 UART at 3F8h: bytes written to THR are collected into lines,
+ *   divisor latch and loopback writes are left out, and any change to the
+ *   line settings is reported as e.g. "115200 8N1".
+ * - Bochs/QEMU style console at E9h: every byte is a character.
+ * - CMOS/RTC at 70h/71h: each write to 71h is reported along with the index
+ *   selected through 70h, and so are changes to the NMI mask bit. Reads don't
+ *   show up on a write-only capture, so index writes alone are not reported.
+ *
+ * @par
+ * Text is handed out a line at a time, or when Flush() is called, through
+ * emit(Source, const char*). The string only lives for the duration of the
+ * call. There's no allocation anywhere, everything lives in fixed buffers.
+ */
+class ConsoleDecoder {
+public:
+    static constexpr uint16_t c_uartBase { 0x3F8 };
+    static constexpr uint16_t c_debugPort { 0xE9 };
+    static constexpr uint16_t c_cmosIndex { 0x70 };
+    static constexpr uint16_t c_cmosData { 0x71 };
+    static constexpr size_t c_maxLine { 80 };
+
+    enum class Source : uint8_t {
+        Uart,
+        Debug,
+        Cmos,
+    };
+
+    static const char* SourceName(Source source)
+    {
+        switch (source) {
+        case Source::Uart:
+            return "COM1";
+        case Source::Debug:
+            return "E9h";
+        default:
+            return "CMOS";
+        }
+    }
+
+    bool Matches(uint16_t port) const
+    {
+        return (port >= c_uartBase && port < c_uartBase + 8) || port == c_debugPort || port == c_cmosIndex
+            || port == c_cmosData;
+    }
+
+    // Back to power-on state, pending text is thrown away
+    void Reset()
+    {
+        uart = {};
+        debug = {};
+        cmosIndex = 0;
+        nmiMasked = false;
+    }
+
+    template <typename Emit>
+    void Feed(uint16_t port, uint8_t data, Emit&& emit)
+    {
+        if (port == c_debugPort) {
+            Put(debug, Source::Debug, data, emit);
+        } else if (port == c_cmosIndex) {
+            const bool masked = data & 0x80;
+            if (masked != nmiMasked) {
+                nmiMasked = masked;
+                emit(Source::Cmos, masked ? "NMI masked" : "NMI unmasked");
+            }
+            cmosIndex = data & 0x7F;
+        } else if (port == c_cmosData) {
+            char record[16];
+            snprintf(record, sizeof(record), "%02Xh <- %02Xh", cmosIndex, data);
+            emit(Source::Cmos, record);
+        } else if (port >= c_uartBase && port < c_uartBase + 8) {
+            FeedUart(port - c_uartBase, data, emit);
+        }
+    }
+
+    // Sends out whatever text is still waiting for its end of line
+    template <typename Emit>
+    void Flush(Emit&& emit)
+    {
+        EndLine(uart.line, Source::Uart, emit);
+        EndLine(debug, Source::Debug, emit);
+    }
+
+    // True if some text is waiting for Flush()
+    bool Pending() const
+    {
+        return uart.line.length > 0 || debug.length > 0;
+    }
+
+private:
+    static constexpr uint32_t c_uartClockHz { 1843200 };
+
+    // UART register offsets, as written to
+    enum UartRegister : uint8_t {
+        UR_Thr = 0, ///< Divisor low with DLAB set
+        UR_Ier = 1, ///< Divisor high with DLAB set
+        UR_Lcr = 3,
+        UR_Mcr = 4,
+    };
+
+    struct Line {
+        char text[c_maxLine + 1] { '\0' };
+        size_t length { 0 };
+    };
+
+    struct Uart {
+        Line line {};
+        uint8_t lcr { 0x03 };
+        uint8_t mcr { 0x00 };
+        uint16_t divisor { 0 };
+        bool changed { false };
+    };
+
+    Uart uart {};
+    Line debug {};
+    uint8_t cmosIndex { 0 };
+    bool nmiMasked { false };
+
+    template <typename Emit>
+    void FeedUart(uint16_t reg, uint8_t data, Emit&& emit)
+    {
+        const bool dlab = uart.lcr & 0x80;
+        switch (reg) {
+        case UR_Thr: {
+            if (dlab) {
+                uart.divisor = (uart.divisor & 0xFF00) | data;
+                uart.changed = true;
+            } else if (!(uart.mcr & 0x10)) {
+                // In loopback, nothing makes it to the line
+                Put(uart.line, Source::Uart, data, emit);
+            }
+        } break;
+
+        case UR_Ier: {
+            if (dlab) {
+                uart.divisor = static_cast<uint16_t>((uart.divisor & 0x00FF) | (data << 8));
+                uart.changed = true;
+            }
+        } break;
+
+        case UR_Lcr: {
+            uart.changed |= (data & 0x7F) != (uart.lcr & 0x7F);
+            uart.lcr = data;
+            if (!(data & 0x80) && uart.changed && uart.divisor != 0) {
+                // Settings only matter once the divisor latch is closed again
+                static constexpr char parity[] { 'N', 'O', 'N', 'E', 'N', 'M', 'N', 'S' };
+                char record[24];
+                snprintf(record, sizeof(record), "%lu %u%c%u",
+                    static_cast<unsigned long>(c_uartClockHz / 16 / uart.divisor), 5u + (data & 0x03),
+                    parity[(data >> 3) & 0x07], (data & 0x04) ? 2u : 1u);
+                EndLine(uart.line, Source::Uart, emit);
+                emit(Source::Uart, record);
+                uart.changed = false;
+            }
+        } break;
+
+        case UR_Mcr: {
+            uart.mcr = data;
+        } break;
+
+        default: {
+            // FCR, scratch and the read-only ones don't change what goes out
+        } break;
+        }
+    }
+
+    template <typename Emit>
+    static void Put(Line& line, Source source, uint8_t data, Emit&& emit)
+    {
+        switch (data) {
+        case '\n': {
+            EndLine(line, source, emit, true);
+        } break;
+
+        case '\r':
+        case '\0': {
+            // Line endings are up to us, NULs are padding
+        } break;
+
+        case '\b': {
+            if (line.length > 0) {
+                line.length--;
+            }
+        } break;
+
+        default: {
+            // Escape sequences and box drawing don't survive a text terminal anyway
+            line.text[line.length++] = (data >= 0x20 && data < 0x7F) ? static_cast<char>(data) : '.';
+            if (line.length == c_maxLine) {
+                EndLine(line, source, emit);
+            }
+        } break;
+        }
+    }
+
+    template <typename Emit>
+    static void EndLine(Line& line, Source source, Emit&& emit, bool evenIfEmpty = false)
+    {
+        if (line.length == 0 && !evenIfEmpty) {
+            return;
+        }
+        line.text[line.length] = '\0';
+        emit(source, line.text);
+        line.length = 0;
+    }
+};
+
+#endif // PICOPOST_CONSOLE_HPP
@@ -0,0 +1,134 @@
+/**
+ * @file cyclestats.hpp
+ * @brief Per-port IO cycle timing histograms, built by the capture core.
+ *
+ */
+
+#ifndef PICOPOST_CYCLESTATS_HPP
+#define PICOPOST_CYCLESTATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief How long bus_ready stayed high for each IO write, and how long the
+ * bus stayed quiet before it, sorted by port.
+ *
+ * @par
+ * Only counters are kept, so the whole thing fits in a couple of KB no matter
+ * how long it runs, and it can be dumped over USB in a few lines. Widths go
+ * into linear bins one 8 MHz BCLK wide, which is where wait states show up.
+ * Gaps span anything from back-to-back cycles to whole seconds, so their bins
+ * double in size each time.
+ *
+ * @par
+ * The first c_maxPorts ports to show up get their own histograms, all the
+ * others are added up together. Keep instances out of the stack.
+ */
+class CycleStats {
+public:
+    static constexpr size_t c_maxPorts { 16 };
+    static constexpr size_t c_bins { 16 };
+    static constexpr uint32_t c_widthBinNs { 125 };
+    static constexpr uint32_t c_gapBaseNs { 250 }; // Top of the first gap bin
+    static constexpr uint32_t c_noGap { UINT32_MAX }; // Previous cycle unknown, e.g. after a PIO stall
+
+    struct Port {
+        uint16_t address { 0 };
+        uint32_t cycles { 0 };
+        uint32_t widthMinNs { UINT32_MAX };
+        uint32_t widthMaxNs { 0 };
+        uint64_t widthSumNs { 0 };
+        std::array<uint32_t, c_bins> widthBins {};
+        std::array<uint32_t, c_bins> gapBins {};
+    };
+
+    void Clear()
+    {
+        ports.fill({});
+        used = 0;
+        others = {};
+        total = 0;
+        stalls = 0;
+    }
+
+    void Add(uint16_t address, uint32_t widthNs, uint32_t gapNs)
+    {
+        Port& port = Find(address);
+        port.cycles++;
+        port.widthMinNs = std::min(port.widthMinNs, widthNs);
+        port.widthMaxNs = std::max(port.widthMaxNs, widthNs);
+        port.widthSumNs += widthNs;
+        port.widthBins[WidthBin(widthNs)]++;
+        if (gapNs != c_noGap) {
+            port.gapBins[GapBin(gapNs)]++;
+        }
+        total++;
+    }
+
+    // Cycles lost to PIO stalls, their timings couldn't be trusted
+    void AddStall()
+    {
+        stalls++;
+    }
+
+    // Ports with their own histograms, in order of appearance
+    std::span<const Port> Ports() const
+    {
+        return { ports.data(), used };
+    }
+
+    // Everything that didn't fit in Ports()
+    const Port& Others() const
+    {
+        return others;
+    }
+
+    uint32_t Total() const
+    {
+        return total;
+    }
+
+    uint32_t Stalls() const
+    {
+        return stalls;
+    }
+
+    static constexpr size_t WidthBin(uint32_t ns)
+    {
+        return std::min<size_t>(ns / c_widthBinNs, c_bins - 1);
+    }
+
+    // Bin 0 is below c_gapBaseNs, bin N up to c_gapBaseNs << N, the last one catches the rest
+    static constexpr size_t GapBin(uint32_t ns)
+    {
+        return std::min<size_t>(std::bit_width(ns / c_gapBaseNs), c_bins - 1);
+    }
+
+private:
+    std::array<Port, c_maxPorts> ports {};
+    size_t used { 0 };
+    Port others {};
+    uint32_t total { 0 };
+    uint32_t stalls { 0 };
+
+    Port& Find(uint16_t address)
+    {
+        for (size_t idx = 0; idx < used; idx++) {
+            if (ports[idx].address == address) {
+                return ports[idx];
+            }
+        }
+        if (used == c_maxPorts) {
+            return others;
+        }
+        ports[used].address = address;
+        return ports[used++];
+    }
+};
+
+#endif // PICOPOST_CYCLESTATS_HPP
@@ -0,0 +1,174 @@
+/**
+ * @file dmahandoff.hpp
+ * @brief Block addresses handed to the capture DMA, and what comes back from it.
+ *
+ */
+
+#ifndef PICOPOST_DMAHANDOFF_HPP
+#define PICOPOST_DMAHANDOFF_HPP
+
+#include "blockring.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Producer side of a BlockRing, for a data channel re-armed by a
+ * control channel.
+ *
+ * @par
+ * The data channel moves one block worth of words from the RX FIFO, then
+ * chains to the control channel. That one copies the next entry of Table()
+ * to the data channel's write address trigger, and chains to a retire channel
+ * which puts DiscardEntry() back in its place, so each armed entry gets used
+ * once. Both read and write the table as a ring: the hardware never needs the
+ * CPU to keep going, and never writes anywhere but where the table says.
+ *
+ * @par
+ * Entries hold the block in flight and the one after it, everything else
+ * points to the discard buffer. The completion IRQ calls Advance() with how
+ * far the control channel got through the table: finished blocks get
+ * published, and the entry after the next one is armed. If the IRQ runs late,
+ * however late, the data channel fills the blocks armed beforehand and then
+ * goes on into the discard buffer. Those blocks are counted by Discarded(),
+ * and reported to the ring with BlockRing::Lose() right before the next block
+ * that made it, where the consumer will find them. Only more than Slots
+ * blocks going by without an IRQ makes that count wrap.
+ *
+ * @par
+ * Advance() has to arm the next entry before the block in flight is done,
+ * that's a whole block's worth of bus cycles, against a few microseconds.
+ *
+ * @par
+ * Nothing in here touches the hardware, so it can be built and exercised on
+ * a host machine against a simulated FIFO.
+ */
+template <typename T, size_t BlockSize, size_t BlockCount, size_t Slots = 8>
+class DmaHandoff {
+    static_assert((Slots & (Slots - 1)) == 0, "Slots must be a power of 2");
+    static_assert(Slots >= 4, "The table needs room for discard entries");
+
+public:
+    using Ring = BlockRing<T, BlockSize, BlockCount>;
+    static constexpr size_t c_slots { Slots };
+    static constexpr size_t c_tableBytes { Slots * sizeof(uintptr_t) };
+
+    // Only safe while no transfer is in flight. Arms the first two entries.
+    void Reset(Ring* blocks, T* discardBlock)
+    {
+        ring = blocks;
+        discardEntry = reinterpret_cast<uintptr_t>(discardBlock);
+        table.fill(discardEntry);
+        bases.fill(discardEntry);
+        real.fill(false);
+        started = 0;
+        done = 0;
+        armed = 0;
+        pendingLost = 0;
+        discarded.store(0, std::memory_order_relaxed);
+        Arm();
+        Arm();
+    }
+
+    // Read by the control channel, written by the retire channel. Aligned to its size, for their rings.
+    uintptr_t* Table()
+    {
+        return table.data();
+    }
+
+    // Read by the retire channel
+    const uintptr_t* DiscardEntry() const
+    {
+        return &discardEntry;
+    }
+
+    // IRQ: the control channel loaded an entry. `consumed` counts entries it read, modulo Slots.
+    void Advance(size_t consumed)
+    {
+        const size_t now = started + ((consumed - started) & (Slots - 1));
+
+        // Everything before the block in flight is done with
+        while (done + 1 < now) {
+            const size_t slot = done & (Slots - 1);
+            if (real[slot]) {
+                ReportLost();
+                ring->Complete();
+            } else {
+                discarded.fetch_add(1, std::memory_order_relaxed);
+                pendingLost += BlockSize;
+            }
+            real[slot] = false;
+            done++;
+        }
+        started = now;
+
+        // Before the consumer gets to peek into it
+        if (real[done & (Slots - 1)]) {
+            ReportLost();
+        }
+
+        // Entries read while not armed went to the discard buffer, only the next one counts
+        armed = std::max(armed, now);
+        while (armed <= now) {
+            Arm();
+        }
+    }
+
+    // Consumer, with the IRQ held off: words landed in the block in flight, given the data channel's write address
+    size_t Landed(uintptr_t writeAddr) const
+    {
+        const size_t slot = done & (Slots - 1);
+        if (!real[slot]) {
+            return 0;
+        }
+
+        // A full block isn't published yet, the IRQ will get to it
+        const uintptr_t base = bases[slot];
+        if (writeAddr < base || writeAddr >= base + BlockSize * sizeof(T)) {
+            return 0;
+        }
+        return (writeAddr - base) / sizeof(T);
+    }
+
+    // Blocks that went to the discard buffer
+    uint32_t Discarded() const
+    {
+        return discarded.load(std::memory_order_relaxed);
+    }
+
+private:
+    void ReportLost()
+    {
+        if (pendingLost > 0) {
+            ring->Lose(pendingLost);
+            pendingLost = 0;
+        }
+    }
+
+    void Arm()
+    {
+        const size_t slot = armed & (Slots - 1);
+        T* block = ring->Arm();
+        real[slot] = (block != nullptr);
+        // Ring is full, keep the FIFO flowing and throw this block away
+        bases[slot] = real[slot] ? reinterpret_cast<uintptr_t>(block) : discardEntry;
+        table[slot] = bases[slot];
+        armed++;
+    }
+
+    alignas(c_tableBytes) std::array<uintptr_t, Slots> table {};
+    std::array<uintptr_t, Slots> bases {}; // As armed, the table only holds them until used
+    std::array<bool, Slots> real {};
+    Ring* ring { nullptr };
+    uintptr_t discardEntry { 0 };
+    size_t started { 0 }; // Entries the control channel read, as of the last Advance()
+    size_t done { 0 }; // Block in flight
+    size_t armed { 0 }; // Entries filled in
+    uint32_t pendingLost { 0 }; // Words discarded since the last block that made it
+    std::atomic<uint32_t> discarded { 0 };
+};
+
+#endif // PICOPOST_DMAHANDOFF_HPP
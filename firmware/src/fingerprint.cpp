@@ -0,0 +1,249 @@
+#include "fingerprint.hpp"
+
+#include <iterator>
+#include <string_view>
+
+static constexpr size_t FP_MAX_LENGTH { 8 };
+static constexpr uint8_t FP_NONE { 0xFF };
+
+struct FpSource {
+    BiosVendor vendor;
+    const char* version;
+    uint8_t length;
+    uint8_t codes[FP_MAX_LENGTH];
+};
+
+// Only ever looked at while compiling, apart from the version strings
+static constexpr FpSource FP_SOURCES[] {
+#include "postsigs.inc"
+};
+static constexpr size_t FP_SIGNATURES { std::size(FP_SOURCES) };
+static_assert(FP_SIGNATURES > 0, "No BIOS fingerprints, check cdb/*.txt");
+
+static constexpr size_t FpMaxNodes()
+{
+    size_t nodes = 1;
+    for (const auto& source : FP_SOURCES) {
+        nodes += source.length;
+    }
+    return nodes;
+}
+static constexpr size_t FP_MAX_NODES { FpMaxNodes() };
+static_assert(FP_MAX_NODES <= UINT16_MAX, "Too many BIOS fingerprints");
+
+struct FpFamily {
+    BiosVendor vendor { BiosVendor::None };
+    const char* version { "" };
+};
+
+struct FpEdge {
+    uint8_t code { 0 };
+    uint16_t child { 0 };
+};
+
+struct FpNode {
+    uint16_t firstEdge { 0 };
+    uint8_t edges { 0 };
+    uint8_t family { FP_NONE }; // Whose fingerprint ends here, if any
+    uint8_t score { 0 };
+    uint16_t fail { 0 }; // Longest proper suffix that's also in the trie
+    uint16_t out { 0 }; // Next node down the fail chain where a fingerprint ends, zero for none
+};
+
+struct FpTable {
+    std::array<FpNode, FP_MAX_NODES> nodes {};
+    std::array<FpEdge, FP_MAX_NODES> edges {};
+    std::array<FpFamily, BiosFingerprint::c_maxFamilies> families {};
+    size_t familyCount { 0 };
+    bool valid { false }; // No fingerprint twice, and few enough families
+};
+
+// Zero when node has no edge for code, the root is nobody's child
+static constexpr uint16_t FpChild(const FpTable& table, uint16_t node, uint8_t code)
+{
+    const FpNode& from = table.nodes[node];
+    for (size_t edge = from.firstEdge; edge < from.firstEdge + from.edges; edge++) {
+        if (table.edges[edge].code == code) {
+            return table.edges[edge].child;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Builds the automaton: a trie of every fingerprint, with edges stored
+ * per node, then fail and output links filled in breadth first.
+ */
+static constexpr FpTable FpBuild()
+{
+    FpTable table {};
+
+    std::array<uint8_t, FP_SIGNATURES> familyOf {};
+    for (size_t sig = 0; sig < FP_SIGNATURES; sig++) {
+        const auto& source = FP_SOURCES[sig];
+        size_t family = 0;
+        while (family < table.familyCount
+            && !(table.families[family].vendor == source.vendor
+                && std::string_view { table.families[family].version } == source.version)) {
+            family++;
+        }
+        if (family == table.familyCount) {
+            if (family == table.families.size()) {
+                return table;
+            }
+            table.families[table.familyCount++] = { .vendor = source.vendor, .version = source.version };
+        }
+        familyOf[sig] = static_cast<uint8_t>(family);
+    }
+
+    std::array<uint16_t, FP_MAX_NODES> parent {};
+    std::array<uint8_t, FP_MAX_NODES> codeOf {};
+    size_t count = 1;
+    for (size_t sig = 0; sig < FP_SIGNATURES; sig++) {
+        uint16_t node = 0;
+        for (size_t idx = 0; idx < FP_SOURCES[sig].length; idx++) {
+            const uint8_t code = FP_SOURCES[sig].codes[idx];
+            uint16_t child = 0;
+            for (size_t other = 1; other < count && child == 0; other++) {
+                if (parent[other] == node && codeOf[other] == code) {
+                    child = static_cast<uint16_t>(other);
+                }
+            }
+            if (child == 0) {
+                child = static_cast<uint16_t>(count++);
+                parent[child] = node;
+                codeOf[child] = code;
+            }
+            node = child;
+        }
+        if (table.nodes[node].family != FP_NONE) {
+            return table;
+        }
+        table.nodes[node].family = familyOf[sig];
+        table.nodes[node].score = FP_SOURCES[sig].length;
+    }
+
+    size_t edges = 0;
+    for (size_t node = 0; node < count; node++) {
+        table.nodes[node].firstEdge = static_cast<uint16_t>(edges);
+        for (size_t child = 1; child < count; child++) {
+            if (parent[child] == node) {
+                table.edges[edges++] = { .code = codeOf[child], .child = static_cast<uint16_t>(child) };
+                table.nodes[node].edges++;
+            }
+        }
+    }
+
+    // Children of the root fail back to it, everyone else to the longest suffix found one level up
+    std::array<uint16_t, FP_MAX_NODES> queue {};
+    size_t head = 0;
+    size_t tail = 0;
+    queue[tail++] = 0;
+    while (head < tail) {
+        const uint16_t node = queue[head++];
+        const FpNode& from = table.nodes[node];
+        for (size_t edge = from.firstEdge; edge < from.firstEdge + from.edges; edge++) {
+            const uint16_t child = table.edges[edge].child;
+            uint16_t fail = 0;
+            if (node != 0) {
+                uint16_t suffix = table.nodes[node].fail;
+                while (true) {
+                    fail = FpChild(table, suffix, table.edges[edge].code);
+                    if (fail != 0 || suffix == 0) {
+                        break;
+                    }
+                    suffix = table.nodes[suffix].fail;
+                }
+            }
+            table.nodes[child].fail = fail;
+            table.nodes[child].out = (table.nodes[fail].family != FP_NONE) ? fail : table.nodes[fail].out;
+            queue[tail++] = child;
+        }
+    }
+
+    table.valid = true;
+    return table;
+}
+
+static constexpr FpTable FP_TABLE { FpBuild() };
+static_assert(FP_TABLE.valid, "Same BIOS fingerprint listed twice, or too many BIOS versions, check cdb/*.txt");
+
+bool BiosFingerprint::Code(uint16_t port, uint8_t code)
+{
+    if (done) {
+        return false;
+    }
+
+    size_t found = 0;
+    while (found < laneCount && lanes[found].port != port) {
+        found++;
+    }
+    if (found == laneCount) {
+        if (laneCount == c_maxPorts) {
+            return false;
+        }
+        lanes[laneCount++].port = port;
+    }
+    Lane& lane = lanes[found];
+    if (code == lane.lastCode) {
+        return false;
+    }
+    lane.lastCode = code;
+    lane.codes++;
+
+    uint16_t node = lane.node;
+    uint16_t next = FpChild(FP_TABLE, node, code);
+    while (next == 0 && node != 0) {
+        node = FP_TABLE.nodes[node].fail;
+        next = FpChild(FP_TABLE, node, code);
+    }
+    lane.node = next;
+    uint16_t hit = (FP_TABLE.nodes[next].family != FP_NONE) ? next : FP_TABLE.nodes[next].out;
+    while (hit != 0) {
+        lane.scores[FP_TABLE.nodes[hit].family] += FP_TABLE.nodes[hit].score;
+        hit = FP_TABLE.nodes[hit].out;
+    }
+
+    uint16_t runnerUp = 0;
+    const Result best = Best(lane, runnerUp);
+    if (best.score >= c_minScore && best.score >= 2 * runnerUp) {
+        result = best;
+        result.sure = true;
+        done = true;
+        return true;
+    }
+    if (lane.codes < c_maxCodes) {
+        return false;
+    }
+
+    // The busiest port had its chance, go with the best guess across all of them
+    for (size_t idx = 0; idx < laneCount; idx++) {
+        const Result candidate = Best(lanes[idx], runnerUp);
+        if (candidate.score > result.score) {
+            result = candidate;
+        }
+    }
+    done = true;
+    return true;
+}
+
+BiosFingerprint::Result BiosFingerprint::Best(const Lane& lane, uint16_t& runnerUp) const
+{
+    Result best {};
+    runnerUp = 0;
+    for (size_t family = 0; family < FP_TABLE.familyCount; family++) {
+        const uint16_t score = lane.scores[family];
+        if (score > best.score) {
+            runnerUp = best.score;
+            best = {
+                .vendor = FP_TABLE.families[family].vendor,
+                .version = FP_TABLE.families[family].version,
+                .port = lane.port,
+                .score = score,
+            };
+        } else if (score > runnerUp) {
+            runnerUp = score;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file fingerprint.hpp
+ * @brief Tells which BIOS is booting from the order of its POST codes.
+ *
+ */
+
+#ifndef PICOPOST_FINGERPRINT_HPP
+#define PICOPOST_FINGERPRINT_HPP
+
+#include "postcodes.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Streaming BIOS vendor and version matcher, fed one POST code at a
+ * time.
+ *
+ * @par
+ * Each BIOS version in cdb/ comes with a few short runs of codes that it sends
+ * one right after the other, and other BIOSes don't. All of them are compiled
+ * into a single Aho-Corasick automaton, in flash, so every code moves the
+ * matcher by one state and reports every run ending there, overlapping ones
+ * included, whatever the number of runs. Each run found scores its length for
+ * its BIOS version.
+ *
+ * @par
+ * Codes are followed separately for each port, up to c_maxPorts of them, since
+ * a board may write to several. A port is decided as soon as a version scores
+ * at least c_minScore and twice as much as any other one. If no port gets
+ * there within c_maxCodes changes of code each, the best score so far is
+ * handed out as a guess. State is fixed size, a few dozen bytes.
+ */
+class BiosFingerprint {
+public:
+    static constexpr size_t c_maxPorts { 5 };
+    static constexpr size_t c_maxFamilies { 8 }; // BIOS versions across all of cdb/
+    static constexpr uint8_t c_maxCodes { 48 };
+    static constexpr uint16_t c_minScore { 9 };
+
+    struct Result {
+        BiosVendor vendor { BiosVendor::None }; // None if nothing matched at all
+        const char* version { "" };
+        uint16_t port { 0 };
+        uint16_t score { 0 };
+        bool sure { false }; // Won by a margin, as opposed to the best guess
+    };
+
+    // Starts over, for the next boot
+    void Reset()
+    {
+        lanes = {};
+        laneCount = 0;
+        done = false;
+        result = {};
+    }
+
+    /**
+     * @brief Adds a POST code write. Same code as the last one on the port is
+     * ignored.
+     *
+     * @return true if this code decided the result
+     */
+    bool Code(uint16_t port, uint8_t code);
+
+    bool Done() const
+    {
+        return done;
+    }
+
+    // Only meaningful once Done()
+    const Result& GetResult() const
+    {
+        return result;
+    }
+
+    // Most codes looked at on a single port so far
+    uint8_t Seen() const
+    {
+        uint8_t seen = 0;
+        for (size_t lane = 0; lane < laneCount; lane++) {
+            seen = (lanes[lane].codes > seen) ? lanes[lane].codes : seen;
+        }
+        return seen;
+    }
+
+private:
+    struct Lane {
+        uint16_t port { 0 };
+        uint16_t node { 0 }; // Automaton state, zero is the root
+        int16_t lastCode { -1 };
+        uint8_t codes { 0 };
+        std::array<uint16_t, c_maxFamilies> scores {};
+    };
+
+    std::array<Lane, c_maxPorts> lanes {};
+    size_t laneCount { 0 };
+    bool done { false };
+    Result result {};
+
+    // Best family of a lane, and the margin it has over the second best
+    Result Best(const Lane& lane, uint16_t& runnerUp) const;
+};
+
+#endif // PICOPOST_FINGERPRINT_HPP
@@ -0,0 +1,607 @@
+/**
+ * @file flashlog.hpp
+ * @brief Bus events recorded to flash, one session per boot.
+ *
+ */
+
+#ifndef PICOPOST_FLASHLOG_HPP
+#define PICOPOST_FLASHLOG_HPP
+
+#include "common.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @brief Circular log of BusEvents in a flash region, with sessions split at
+ * each reset deassertion.
+ *
+ * @par
+ * Events are packed into page-sized blocks in RAM: a tag byte, then only what
+ * can't be guessed (the port when it changed, non-zero data, non-zero time
+ * delta as a varint), so a POST code takes 4-5 bytes instead of 8. Each block
+ * is self-contained, with a header telling its session, event count and time
+ * span, and gets programmed as soon as it's full, from Service().
+ *
+ * @par
+ * Sectors are written in turn, round robin, so they all wear the same and the
+ * oldest data goes first once the region is full. The first page of each
+ * sector holds its header: a sequence number, to find the newest sector again
+ * after a power cycle, and how many times it got erased. Erasing takes tens of
+ * milliseconds, so it's done ahead of the write position, up to c_eraseAhead
+ * sectors, whenever Service() is told the bus is quiet. Programming a page is
+ * then all that's left to do while events are flowing. Only if the reserve
+ * runs dry does a page wait for an erase, which is counted.
+ *
+ * @par
+ * A reset deassertion starts a new session, in a block of its own. Sessions
+ * are found again by walking block headers, no separate index has to be kept
+ * up to date, and a power loss costs at most the blocks still in RAM.
+ *
+ * @par
+ * Nothing in here touches the hardware: Flash provides c_pageSize,
+ * c_sectorSize, Sectors(), Read(offset) for memory mapped reads, Erase(sector)
+ * and Program(offset, page). The block and index logic can then be exercised
+ * on a host machine against a simulated flash.
+ *
+ * @par
+ * Add(), Service() and Finish() belong to the recording core, everything else
+ * is only safe while nothing is being recorded.
+ */
+template <typename Flash>
+class FlashLog {
+public:
+    static constexpr size_t c_pageSize { Flash::c_pageSize };
+    static constexpr size_t c_sectorSize { Flash::c_sectorSize };
+    static constexpr size_t c_pagesPerSector { c_sectorSize / c_pageSize };
+    static constexpr size_t c_eraseAhead { 4 }; // Sectors kept erased ahead of the write position
+    static constexpr size_t c_pageQueue { 8 }; // Blocks in RAM, enough for a whole DMA block of POST codes
+
+    struct Session {
+        uint32_t id { 0 };
+        uint32_t events { 0 };
+        uint32_t bytes { 0 }; // Packed size, block headers left out
+        uint64_t ticks { 0 }; // Sum of event deltas, in CaptureClock units
+        bool truncated { false }; // Its first blocks were overwritten by newer sessions
+    };
+
+    struct Stats {
+        size_t sectors { 0 };
+        size_t pagesUsed { 0 };
+        size_t pagesTotal { 0 };
+        size_t reserve { 0 }; // Sectors erased ahead
+        uint32_t minErases { 0 };
+        uint32_t maxErases { 0 };
+        uint32_t dropped { 0 }; // Events that found no room in RAM, last recording only
+        uint32_t forcedErases { 0 }; // Pages that had to wait for an erase, last recording only
+    };
+
+    Flash& Device()
+    {
+        return flash;
+    }
+
+    /**
+     * @brief Finds where the last recording stopped.
+     *
+     * @return false if the region is too small to be used
+     */
+    bool Mount()
+    {
+        sectors = flash.Sectors();
+        open = false;
+        if (sectors < 2) {
+            return false;
+        }
+
+        uint32_t maxSeq = 0;
+        uint32_t currentSeq = 0;
+        bool found = false;
+        session = 0;
+        for (size_t sector = 0; sector < sectors; sector++) {
+            SectorHeader header {};
+            if (!ReadSector(sector, header)) {
+                continue;
+            }
+            maxSeq = std::max(maxSeq, header.sequence);
+            if (HasData(sector) && (!found || header.sequence > currentSeq)) {
+                found = true;
+                current = sector;
+                currentSeq = header.sequence;
+            }
+            for (size_t page = 1; page < c_pagesPerSector; page++) {
+                PageHeader block {};
+                if (ReadPage(sector, page, block)) {
+                    session = std::max(session, block.session);
+                }
+            }
+        }
+        nextSeq = maxSeq + 1;
+
+        writePage = c_pagesPerSector;
+        if (!found) {
+            // Empty log, writing starts from the first sector
+            current = sectors - 1;
+        } else {
+            PageHeader block {};
+            writePage = 1;
+            while (writePage < c_pagesPerSector && ReadPage(current, writePage, block)) {
+                writePage++;
+            }
+        }
+
+        reserve = 0;
+        while (reserve < sectors - 1) {
+            const size_t sector = (current + reserve + 1) % sectors;
+            SectorHeader header {};
+            if (!ReadSector(sector, header) || HasData(sector)) {
+                break;
+            }
+            reserve++;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Opens a new session, for Add() to record into.
+     *
+     * @return false if the region can't be used
+     */
+    bool Start()
+    {
+        if (!Mount()) {
+            return false;
+        }
+        queued = 0;
+        queueHead = 0;
+        filling = false;
+        session++;
+        sessionStart = true;
+        dropped = 0;
+        lostEvents = 0;
+        lostTicks = 0;
+        forcedErases = 0;
+        open = true;
+        return true;
+    }
+
+    /**
+     * @brief Packs an event into the current block. A reset deassertion starts
+     * a new session, and a new block.
+     *
+     * @par
+     * Events lost before this one go first, as a gap marker that carries
+     * their time too, so the timeline still adds up on replay.
+     *
+     * @return false if every block in RAM is waiting to be programmed, the
+     * event is lost then
+     */
+    bool Add(const BusEvent& event)
+    {
+        if (!open) {
+            return false;
+        }
+        bool stored = FlushLost();
+        if (event.operation == QueueOperation::P80ResetCleared && !sessionStart) {
+            // Unless nothing got recorded since the session opened
+            Close();
+            session++;
+            sessionStart = true;
+        }
+        stored = stored && Put(event);
+        if (!stored) {
+            dropped++;
+            lostEvents++;
+            lostTicks += event.delta;
+        }
+        return stored;
+    }
+
+    // Whether Service(quiet) has anything to erase or program
+    bool Pending(bool quiet) const
+    {
+        return queued > 0 || EraseDue(quiet);
+    }
+
+    /**
+     * @brief Programs the blocks that are full, and erases ahead.
+     *
+     * @param quiet The bus is idle, a good time to erase a sector. Erasing
+     * happens anyway when no erased sector is left.
+     */
+    void Service(bool quiet)
+    {
+        while (queued > 0) {
+            if (writePage == c_pagesPerSector) {
+                if (reserve == 0) {
+                    EraseAhead();
+                    forcedErases++;
+                }
+                current = (current + 1) % sectors;
+                reserve--;
+                writePage = 1;
+            }
+            flash.Program(PageOffset(current, writePage), queue[queueHead].data());
+            writePage++;
+            queueHead = (queueHead + 1) % c_pageQueue;
+            queued--;
+        }
+        if (EraseDue(quiet)) {
+            EraseAhead();
+        }
+    }
+
+    // Programs whatever is left in RAM, then stops recording
+    void Finish()
+    {
+        if (!open) {
+            return;
+        }
+        // Blocks in RAM go first, to make room for a last gap marker
+        Service(true);
+        FlushLost();
+        Close();
+        Service(true);
+        open = false;
+    }
+
+    // Calls visit(const Session&) for every session still in the log, oldest first
+    template <typename Visit>
+    void ForEachSession(Visit&& visit) const
+    {
+        Session run {};
+        bool running = false;
+        ForEachPage([&](const PageHeader& block, const uint8_t*) {
+            if (running && block.session != run.id) {
+                visit(run);
+                running = false;
+            }
+            if (!running) {
+                run = { .id = block.session, .truncated = !(block.flags & PF_SessionStart) };
+                running = true;
+            }
+            run.events += block.events;
+            run.bytes += block.used;
+            run.ticks += block.ticks;
+        });
+        if (running) {
+            visit(run);
+        }
+    }
+
+    /**
+     * @brief Unpacks every event of a session, in order, through
+     * emit(const BusEvent&).
+     *
+     * @return false if the session isn't in the log
+     */
+    template <typename Emit>
+    bool Replay(uint32_t id, Emit&& emit) const
+    {
+        bool found = false;
+        ForEachPage([&](const PageHeader& block, const uint8_t* payload) {
+            if (block.session != id) {
+                return;
+            }
+            found = true;
+            const uint8_t* end = payload + std::min<size_t>(block.used, c_pageSize - sizeof(PageHeader));
+            uint16_t lastAddress = 0;
+            BusEvent event {};
+            while (payload < end && Decode(payload, end, lastAddress, event)) {
+                emit(event);
+            }
+        });
+        return found;
+    }
+
+    // Erases the whole region, sessions start over from 1
+    void Wipe()
+    {
+        sectors = flash.Sectors();
+        for (size_t sector = 0; sector < sectors; sector++) {
+            flash.Erase(sector);
+        }
+        Mount();
+    }
+
+    Stats GetStats() const
+    {
+        Stats stats {
+            .sectors = sectors,
+            .pagesTotal = sectors * (c_pagesPerSector - 1),
+            .reserve = reserve,
+            .minErases = UINT32_MAX,
+            .dropped = dropped,
+            .forcedErases = forcedErases,
+        };
+        for (size_t sector = 0; sector < sectors; sector++) {
+            SectorHeader header {};
+            const uint32_t erases = ReadSector(sector, header) ? header.erases : 0;
+            stats.minErases = std::min(stats.minErases, erases);
+            stats.maxErases = std::max(stats.maxErases, erases);
+        }
+        if (sectors == 0) {
+            stats.minErases = 0;
+        }
+        ForEachPage([&stats](const PageHeader&, const uint8_t*) { stats.pagesUsed++; });
+        return stats;
+    }
+
+private:
+    static constexpr uint32_t c_sectorMagic { 0x50504C47 }; // "PPLG"
+    static constexpr uint16_t c_pageMagic { 0x5042 };
+    static constexpr size_t c_maxRecord { 1 + 2 + 1 + 5 }; // Tag, address, data, 32-bit varint
+
+    // Tag byte, operation in the low nibble
+    enum RecordTag : uint8_t {
+        RT_Operation = 0x0F,
+        RT_Address = 0x10, ///< Address follows, otherwise the last P80Data one, or zero for other events
+        RT_Data = 0x20, ///< Data follows, otherwise zero
+        RT_Delta = 0x40, ///< Delta follows as a varint, otherwise zero
+    };
+    static_assert(static_cast<uint8_t>(QueueOperation::CalibrationDone) <= RT_Operation,
+        "Operations don't fit the record tag anymore");
+
+    enum PageFlags : uint8_t {
+        PF_SessionStart = 0x01,
+    };
+
+    struct SectorHeader {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t erases;
+    };
+
+    struct PageHeader {
+        uint64_t ticks;
+        uint32_t session;
+        uint16_t used; // Payload bytes
+        uint16_t events;
+        uint16_t magic;
+        uint8_t flags;
+        uint8_t reserved;
+    };
+
+    using Page = std::array<uint8_t, c_pageSize>;
+
+    Flash flash {};
+    size_t sectors { 0 };
+    size_t current { 0 }; // Sector being written
+    size_t writePage { 0 }; // Next page to program in it
+    size_t reserve { 0 }; // Erased sectors right after it
+    uint32_t nextSeq { 1 };
+    uint32_t session { 0 };
+    bool open { false };
+    bool sessionStart { false }; // Next block opens a session
+    std::array<Page, c_pageQueue> queue {};
+    size_t queueHead { 0 }; // Oldest full block
+    size_t queued { 0 };
+    bool filling { false }; // Block after the queued ones is being filled
+    size_t fill { 0 };
+    PageHeader pageHeader {};
+    uint16_t lastAddress { 0 };
+    uint32_t dropped { 0 };
+    uint32_t lostEvents { 0 }; // Dropped since the last gap marker
+    uint64_t lostTicks { 0 }; // Their deltas
+    uint32_t forcedErases { 0 };
+
+    size_t Slot(size_t index) const
+    {
+        return (queueHead + index) % c_pageQueue;
+    }
+
+    static size_t PageOffset(size_t sector, size_t page)
+    {
+        return sector * c_sectorSize + page * c_pageSize;
+    }
+
+    bool ReadSector(size_t sector, SectorHeader& header) const
+    {
+        memcpy(&header, flash.Read(PageOffset(sector, 0)), sizeof(header));
+        return header.magic == c_sectorMagic;
+    }
+
+    bool ReadPage(size_t sector, size_t page, PageHeader& header) const
+    {
+        memcpy(&header, flash.Read(PageOffset(sector, page)), sizeof(header));
+        return header.magic == c_pageMagic;
+    }
+
+    // Pages are programmed in order, so the first one tells
+    bool HasData(size_t sector) const
+    {
+        PageHeader header {};
+        return ReadPage(sector, 1, header);
+    }
+
+    // Calls visit(header, payload) for every block in the log, oldest first
+    template <typename Visit>
+    void ForEachPage(Visit&& visit) const
+    {
+        for (size_t step = 0; step < sectors; step++) {
+            const size_t sector = (current + reserve + 1 + step) % sectors;
+            SectorHeader header {};
+            if (!ReadSector(sector, header)) {
+                continue;
+            }
+            for (size_t page = 1; page < c_pagesPerSector; page++) {
+                PageHeader block {};
+                if (!ReadPage(sector, page, block)) {
+                    break;
+                }
+                visit(block, flash.Read(PageOffset(sector, page)) + sizeof(PageHeader));
+            }
+        }
+    }
+
+    bool EraseDue(bool quiet) const
+    {
+        return reserve < c_eraseAhead && reserve < sectors - 1 && (quiet || reserve == 0);
+    }
+
+    void EraseAhead()
+    {
+        const size_t sector = (current + reserve + 1) % sectors;
+        SectorHeader header {};
+        const uint32_t erases = ReadSector(sector, header) ? header.erases + 1 : 1;
+        flash.Erase(sector);
+
+        // OpenPage() never hands out the last slot, so it's free to use
+        Page& page = queue[Slot(c_pageQueue - 1)];
+        page.fill(0xFF);
+        header = { .magic = c_sectorMagic, .sequence = nextSeq++, .erases = erases };
+        memcpy(page.data(), &header, sizeof(header));
+        flash.Program(PageOffset(sector, 0), page.data());
+        reserve++;
+    }
+
+    bool OpenPage()
+    {
+        // The last slot is kept free for sector headers
+        if (queued == c_pageQueue - 1) {
+            return false;
+        }
+        queue[Slot(queued)].fill(0xFF);
+        pageHeader = {
+            .ticks = 0,
+            .session = session,
+            .used = 0,
+            .events = 0,
+            .magic = c_pageMagic,
+            .flags = static_cast<uint8_t>(sessionStart ? PF_SessionStart : 0),
+            .reserved = 0xFF,
+        };
+        sessionStart = false;
+        fill = sizeof(PageHeader);
+        lastAddress = 0;
+        filling = true;
+        return true;
+    }
+
+    bool Put(const BusEvent& event)
+    {
+        if (filling && fill + c_maxRecord > c_pageSize) {
+            Close();
+        }
+        if (!filling && !OpenPage()) {
+            return false;
+        }
+
+        fill += Encode(event, &queue[Slot(queued)][fill]);
+        pageHeader.events++;
+        pageHeader.ticks += event.delta;
+        return true;
+    }
+
+    // Records a gap marker for the events lost so far, with their time
+    bool FlushLost()
+    {
+        if (lostEvents == 0) {
+            return true;
+        }
+        while (lostTicks > BusEvent::c_maxDelta) {
+            if (!Put({ .delta = BusEvent::c_maxDelta })) {
+                return false;
+            }
+            lostTicks -= BusEvent::c_maxDelta;
+        }
+        const BusEvent gap {
+            .delta = static_cast<uint32_t>(lostTicks),
+            .address = static_cast<uint16_t>(std::min<uint32_t>(lostEvents, UINT16_MAX)),
+            .data = LS_FlashLog,
+            .operation = QueueOperation::P80Gap,
+        };
+        if (!Put(gap)) {
+            return false;
+        }
+        lostEvents = 0;
+        lostTicks = 0;
+        return true;
+    }
+
+    // Queues the block being filled, for Service() to program
+    void Close()
+    {
+        if (!filling) {
+            return;
+        }
+        pageHeader.used = static_cast<uint16_t>(fill - sizeof(PageHeader));
+        memcpy(queue[Slot(queued)].data(), &pageHeader, sizeof(PageHeader));
+        queued++;
+        filling = false;
+    }
+
+    size_t Encode(const BusEvent& event, uint8_t* out)
+    {
+        const bool isData = (event.operation == QueueOperation::P80Data);
+        uint8_t tag = static_cast<uint8_t>(event.operation) & RT_Operation;
+        size_t size = 1;
+        if (event.address != (isData ? lastAddress : 0)) {
+            tag |= RT_Address;
+            out[size++] = static_cast<uint8_t>(event.address & 0xFF);
+            out[size++] = static_cast<uint8_t>(event.address >> 8);
+        }
+        if (event.data != 0) {
+            tag |= RT_Data;
+            out[size++] = event.data;
+        }
+        if (event.delta != 0) {
+            tag |= RT_Delta;
+            uint32_t delta = event.delta;
+            while (delta >= 0x80) {
+                out[size++] = static_cast<uint8_t>(delta | 0x80);
+                delta >>= 7;
+            }
+            out[size++] = static_cast<uint8_t>(delta);
+        }
+        out[0] = tag;
+        if (isData) {
+            lastAddress = event.address;
+        }
+        return size;
+    }
+
+    static bool Decode(const uint8_t*& in, const uint8_t* end, uint16_t& lastAddress, BusEvent& event)
+    {
+        const uint8_t tag = *in++;
+        event.operation = static_cast<QueueOperation>(tag & RT_Operation);
+        const bool isData = (event.operation == QueueOperation::P80Data);
+        event.address = isData ? lastAddress : 0;
+        event.data = 0;
+        event.delta = 0;
+        if (tag & RT_Address) {
+            if (end - in < 2) {
+                return false;
+            }
+            event.address = static_cast<uint16_t>(in[0] | (in[1] << 8));
+            in += 2;
+        }
+        if (tag & RT_Data) {
+            if (in == end) {
+                return false;
+            }
+            event.data = *in++;
+        }
+        if (tag & RT_Delta) {
+            for (unsigned int shift = 0; shift < 32; shift += 7) {
+                if (in == end) {
+                    return false;
+                }
+                const uint8_t byte = *in++;
+                event.delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    break;
+                }
+            }
+        }
+        if (isData) {
+            lastAddress = event.address;
+        }
+        return true;
+    }
+};
+
+#endif // PICOPOST_FLASHLOG_HPP
@@ -0,0 +1,270 @@
+/**
+ * @file golden.hpp
+ * @brief Checks each boot against one recorded from a known-good board.
+ *
+ */
+
+#ifndef PICOPOST_GOLDEN_HPP
+#define PICOPOST_GOLDEN_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief Golden reference boot, and a streaming matcher against it.
+ *
+ * @par
+ * A reference is the sequence of POST code changes seen after a reset, each
+ * with its time since reset deassertion. Once one is recorded, every boot
+ * after that is checked as codes come in, one step at a time: the matcher only
+ * remembers where it is in the reference and when the last step matched, so
+ * it needs constant memory and constant time per code, and fails as soon as
+ * something is off instead of waiting for the boot to end:
+ * - a code other than the expected one is a divergence, unless the expected
+ *   one shows up a few steps later, which makes it a missing code;
+ * - a stage taking longer than the reference one, plus tolerance, is slow.
+ *   This is also checked while the stage is still on, with Check().
+ * Boots going faster than the reference are fine. Once the whole reference has
+ * been matched the boot passes, and whatever comes after is not looked at.
+ *
+ * @par
+ * Events lost on PicoPOST's side say nothing about the board: MarkGap() makes
+ * the boot inconclusive instead, or throws a recording away.
+ *
+ * @par
+ * The first failure sticks until the next reset. Recording is armed with
+ * Arm(), starts at the next reset deassertion and ends at the next reset
+ * assertion, or on Stop(). The reference lives in RAM, about 2 KB.
+ */
+class GoldenMatcher {
+public:
+    static constexpr size_t c_maxSteps { 256 };
+    static constexpr size_t c_lookahead { 4 }; // How far a missing code can be told from a divergence
+    static constexpr uint32_t c_defaultTolerancePct { 25 };
+    static constexpr uint32_t c_defaultSlackUs { 50000 };
+
+    enum class State : uint8_t {
+        Empty, ///< No reference yet
+        Armed, ///< Next boot becomes the reference
+        Recording,
+        Waiting, ///< Reference ready, waiting for a reset
+        Running,
+        Pass,
+        Fail,
+        Inconclusive, ///< Events were lost during the boot, or the recording
+    };
+
+    enum class Failure : uint8_t {
+        None,
+        Diverged, ///< Got a code that's nowhere near the expected one
+        Missing, ///< Expected code was skipped
+        Slow, ///< Stage before the expected code is taking too long
+        Overflow, ///< Recording ran out of room, reference is incomplete
+    };
+
+    struct Step {
+        uint8_t code { 0 };
+        uint32_t atUs { 0 }; // Since reset deassertion, saturated
+    };
+
+    struct Status {
+        State state { State::Empty };
+        Failure failure { Failure::None };
+        size_t step { 0 }; // Steps matched, or recorded
+        uint8_t expected { 0 };
+        uint8_t got { 0 };
+        uint32_t tookUs { 0 }; // Slow only, how long the stage has been on
+        uint32_t limitUs { 0 }; // Slow only, reference time plus tolerance
+    };
+
+    const Status& GetStatus() const
+    {
+        return status;
+    }
+
+    std::span<const Step> Reference() const
+    {
+        return { steps.data(), count };
+    }
+
+    uint32_t TolerancePct() const
+    {
+        return tolerancePct;
+    }
+
+    uint32_t SlackUs() const
+    {
+        return slackUs;
+    }
+
+    // Stages can take up to pct percent longer than the reference, plus slackUs
+    void SetTolerance(uint32_t pct, uint32_t slack)
+    {
+        tolerancePct = pct;
+        slackUs = slack;
+    }
+
+    void Arm()
+    {
+        status = { .state = State::Armed };
+    }
+
+    /**
+     * @brief Ends a recording in progress, and keeps it as the reference.
+     *
+     * @return false if nothing was being recorded
+     */
+    bool Stop()
+    {
+        if (status.state != State::Recording) {
+            return false;
+        }
+        status = { .state = (count > 0) ? State::Waiting : State::Empty };
+        return true;
+    }
+
+    // Host reset went active, returns true if the state changed
+    bool ResetAsserted()
+    {
+        if (status.state == State::Recording) {
+            return Stop();
+        }
+        if (status.state == State::Running || status.state == State::Pass || status.state == State::Fail
+            || status.state == State::Inconclusive) {
+            status = { .state = (count > 0) ? State::Waiting : State::Empty };
+            return true;
+        }
+        return false;
+    }
+
+    // Host reset got released, bus time starts from zero here
+    bool ResetCleared()
+    {
+        switch (status.state) {
+        case State::Armed: {
+            count = 0;
+            status = { .state = State::Recording };
+        } break;
+
+        case State::Waiting: {
+            status = { .state = State::Running, .expected = steps[0].code };
+        } break;
+
+        default: {
+            return false;
+        }
+        }
+        lastCode = -1;
+        lastAt = 0;
+        return true;
+    }
+
+    /**
+     * @brief Adds a POST code write. Same code as the last one is ignored.
+     *
+     * @return true if the status changed
+     */
+    bool Code(uint64_t atUs, uint8_t code)
+    {
+        if (code == lastCode) {
+            return false;
+        }
+        lastCode = code;
+        const uint32_t at = static_cast<uint32_t>(std::min<uint64_t>(atUs, UINT32_MAX));
+
+        if (status.state == State::Recording) {
+            if (count == c_maxSteps) {
+                status = { .state = State::Fail, .failure = Failure::Overflow, .step = count };
+                count = 0;
+                return true;
+            }
+            steps[count++] = { .code = code, .atUs = at };
+            status.step = count;
+            return true;
+        }
+        if (status.state != State::Running) {
+            return false;
+        }
+
+        if (Check(atUs)) {
+            return true;
+        }
+        if (code != steps[status.step].code) {
+            const size_t horizon = std::min(count, status.step + 1 + c_lookahead);
+            bool later = false;
+            for (size_t idx = status.step + 1; idx < horizon; idx++) {
+                later |= (steps[idx].code == code);
+            }
+            status.state = State::Fail;
+            status.failure = later ? Failure::Missing : Failure::Diverged;
+            status.got = code;
+            return true;
+        }
+
+        lastAt = at;
+        status.step++;
+        if (status.step == count) {
+            status.state = State::Pass;
+        } else {
+            status.expected = steps[status.step].code;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Events were lost on the capture side. A boot being checked can't
+     * be judged anymore, a recording would miss codes.
+     *
+     * @return true if the status changed
+     */
+    bool MarkGap()
+    {
+        if (status.state == State::Recording) {
+            count = 0;
+            status = { .state = State::Inconclusive };
+            return true;
+        }
+        if (status.state != State::Running) {
+            return false;
+        }
+        status.state = State::Inconclusive;
+        return true;
+    }
+
+    /**
+     * @brief Fails the boot if the current stage is already too slow by nowUs.
+     *
+     * @return true if the status changed
+     */
+    bool Check(uint64_t nowUs)
+    {
+        if (status.state != State::Running) {
+            return false;
+        }
+        const uint32_t refUs = steps[status.step].atUs - ((status.step > 0) ? steps[status.step - 1].atUs : 0);
+        const uint64_t limit = uint64_t { refUs } + uint64_t { refUs } * tolerancePct / 100 + slackUs;
+        const uint64_t took = (nowUs > lastAt) ? nowUs - lastAt : 0;
+        if (took <= limit) {
+            return false;
+        }
+        status.state = State::Fail;
+        status.failure = Failure::Slow;
+        status.tookUs = static_cast<uint32_t>(std::min<uint64_t>(took, UINT32_MAX));
+        status.limitUs = static_cast<uint32_t>(std::min<uint64_t>(limit, UINT32_MAX));
+        return true;
+    }
+
+private:
+    std::array<Step, c_maxSteps> steps {};
+    size_t count { 0 };
+    Status status {};
+    int16_t lastCode { -1 };
+    uint32_t lastAt { 0 }; // When the last step matched
+    uint32_t tolerancePct { c_defaultTolerancePct };
+    uint32_t slackUs { c_defaultSlackUs };
+};
+
+#endif // PICOPOST_GOLDEN_HPP
@@ -0,0 +1,218 @@
+/**
+ * @file heatmap.hpp
+ * @brief Per-port IO write counters, and names for the usual suspects.
+ *
+ */
+
+#ifndef PICOPOST_HEATMAP_HPP
+#define PICOPOST_HEATMAP_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief How many times each IO port got written to, counted in O(1) per
+ * bus cycle by the capture core.
+ *
+ * @par
+ * A full 64K-entry table won't fit in RAM next to everything else, but ISA
+ * cards only decode 10 address bits, so ports below 400h are where pretty much
+ * everything happens: those get an exact counter each. The odd port above that
+ * (EISA slot space, PCI config, chipset extras) goes into a small open
+ * addressing table, with a bounded number of probes. Ports that can't find a
+ * slot are only counted in Spilled().
+ *
+ * @par
+ * Around 5 KB, keep instances out of the stack.
+ */
+class PortHeatmap {
+public:
+    static constexpr size_t c_directPorts { 0x400 };
+    static constexpr size_t c_highSlots { 128 };
+    static constexpr size_t c_maxProbes { 8 };
+
+    struct Entry {
+        uint16_t address { 0 };
+        uint32_t count { 0 };
+    };
+
+    void Clear()
+    {
+        direct.fill(0);
+        high.fill({});
+        total = 0;
+        spilled = 0;
+        stalls = 0;
+    }
+
+    inline void Add(uint16_t address)
+    {
+        total++;
+        if (address < c_directPorts) {
+            direct[address]++;
+            return;
+        }
+
+        size_t slot = Hash(address);
+        for (size_t probe = 0; probe < c_maxProbes; probe++) {
+            Entry& entry = high[slot];
+            if (entry.count == 0) {
+                entry.address = address;
+            }
+            if (entry.address == address) {
+                entry.count++;
+                return;
+            }
+            slot = (slot + 1) % c_highSlots;
+        }
+        spilled++;
+    }
+
+    // Bus cycles lost to PIO stalls, they couldn't be counted
+    void AddStall()
+    {
+        stalls++;
+    }
+
+    uint32_t Total() const
+    {
+        return total;
+    }
+
+    // Writes that were counted in Total() only, the high table was too crowded
+    uint32_t Spilled() const
+    {
+        return spilled;
+    }
+
+    uint32_t Stalls() const
+    {
+        return stalls;
+    }
+
+    /**
+     * @brief Fills top with the busiest ports, busiest first.
+     *
+     * @return How many entries were filled, less than top.size() if fewer
+     * ports showed up
+     */
+    size_t Top(std::span<Entry> top) const
+    {
+        size_t filled = 0;
+        auto offer = [&top, &filled](uint16_t address, uint32_t count) {
+            if (count == 0 || (filled == top.size() && count <= top[filled - 1].count)) {
+                return;
+            }
+            size_t pos = (filled < top.size()) ? filled++ : filled - 1;
+            while (pos > 0 && top[pos - 1].count < count) {
+                top[pos] = top[pos - 1];
+                pos--;
+            }
+            top[pos] = { .address = address, .count = count };
+        };
+
+        if (top.empty()) {
+            return 0;
+        }
+        for (size_t port = 0; port < c_directPorts; port++) {
+            offer(static_cast<uint16_t>(port), direct[port]);
+        }
+        for (const auto& entry : high) {
+            offer(entry.address, entry.count);
+        }
+        return filled;
+    }
+
+    // Calls visit(address, count) for every port seen, low ports in order first
+    template <typename Visit>
+    void ForEach(Visit&& visit) const
+    {
+        for (size_t port = 0; port < c_directPorts; port++) {
+            if (direct[port] > 0) {
+                visit(static_cast<uint16_t>(port), direct[port]);
+            }
+        }
+        for (const auto& entry : high) {
+            if (entry.count > 0) {
+                visit(entry.address, entry.count);
+            }
+        }
+    }
+
+    /**
+     * @brief What usually lives at address on a PC/AT compatible.
+     *
+     * @return A short name, fit for the OLED, or nullptr if unknown
+     */
+    static const char* DeviceName(uint16_t address)
+    {
+        for (const auto& range : c_devices) {
+            if (address >= range.first && address <= range.last) {
+                return range.name;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    struct Device {
+        uint16_t first;
+        uint16_t last;
+        const char* name;
+    };
+
+    // First match wins, so specific ports go before the ranges around them
+    static constexpr Device c_devices[] {
+        { 0x000, 0x01F, "DMA1" },
+        { 0x020, 0x03F, "PIC1" },
+        { 0x040, 0x05F, "PIT" },
+        { 0x060, 0x06F, "KBC" },
+        { 0x070, 0x07F, "RTC" },
+        { 0x080, 0x080, "POST" },
+        { 0x084, 0x084, "POST" },
+        { 0x081, 0x08F, "DMApg" },
+        { 0x090, 0x090, "POST" },
+        { 0x092, 0x092, "A20" },
+        { 0x0A0, 0x0BF, "PIC2" },
+        { 0x0C0, 0x0DF, "DMA2" },
+        { 0x0F0, 0x0FF, "FPU" },
+        { 0x170, 0x177, "IDE2" },
+        { 0x1F0, 0x1F7, "IDE" },
+        { 0x200, 0x207, "Game" },
+        { 0x220, 0x22F, "SB" },
+        { 0x278, 0x27F, "LPT2" },
+        { 0x2E8, 0x2EF, "COM4" },
+        { 0x2F8, 0x2FF, "COM2" },
+        { 0x300, 0x300, "POST" },
+        { 0x330, 0x331, "MIDI" },
+        { 0x376, 0x377, "IDE2" },
+        { 0x378, 0x37F, "LPT1" },
+        { 0x388, 0x38B, "OPL" },
+        { 0x3B0, 0x3BB, "MDA" },
+        { 0x3BC, 0x3BF, "LPT" },
+        { 0x3C0, 0x3DF, "VGA" },
+        { 0x3E8, 0x3EF, "COM3" },
+        { 0x3F6, 0x3F7, "IDE" },
+        { 0x3F0, 0x3F7, "FDC" },
+        { 0x3F8, 0x3FF, "COM1" },
+        { 0x4D0, 0x4D1, "ELCR" },
+        { 0xCF8, 0xCFF, "PCI" },
+    };
+
+    std::array<uint32_t, c_directPorts> direct {};
+    std::array<Entry, c_highSlots> high {};
+    uint32_t total { 0 };
+    uint32_t spilled { 0 };
+    uint32_t stalls { 0 };
+
+    static inline size_t Hash(uint16_t address)
+    {
+        // Fibonacci hashing, EISA slot ports only differ in the top nibble
+        return static_cast<uint16_t>(address * 40503u) >> 9;
+    }
+};
+
+#endif // PICOPOST_HEATMAP_HPP
@@ -1,18 +1,89 @@
 #include "logic.hpp"
 
+#include "hardware/dma.h"
 #include "hardware/pio.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
 
 #include "cfg/pins.h"
 #include "common.hpp"
 #include "fastread.pio.h"
 
+#include <algorithm>
+#include <bit>
 #include <stdio.h>
 
-static constexpr float IOR_CLKDIV { (float)REQ_CLOCK_KHZ / 183000 };
+// Safe defaults, PIO running at about 183 MHz whatever the system clock
+static constexpr BusTiming IOR_DEFAULT_TIMING {
+    .clkDiv256 = static_cast<uint16_t>(std::max(256ull, REQ_CLOCK_KHZ * 256ull / 183000)),
+    .muxDelay = 8,
+};
+static_assert(IOR_DEFAULT_TIMING.StallTicks() == Bus_FastRead_CAPTURE_STALL_TICKS,
+    "Default timings don't match fastread.pio");
+static_assert(IOR_DEFAULT_TIMING.PingPongStallTicks() == Bus_PingPong_PINGPONG_STALL_TICKS,
+    "Default timings don't match fastread.pio");
+
+// Clock dividers tried by the calibration, 8.8 fixed point, slowest first
+static constexpr std::array<uint16_t, 6> IOR_CALIB_DIVIDERS { 512, 461, 410, 358, 307, 256 };
+
+// Each calibration step samples this many cycles, or gives up after a while
+static constexpr uint32_t IOR_CALIB_SAMPLES { 2048 };
+static constexpr uint32_t IOR_CALIB_MIN_SAMPLES { 256 };
+static constexpr uint64_t IOR_CALIB_STEP_US { 250000 };
+static constexpr uint64_t IOR_CALIB_BASELINE_US { 2000000 };
+
+// RESET_DRV lasts milliseconds, anything shorter than this is noise
+static constexpr uint64_t RESET_MIN_US { 10 };
+
+// Bus cycles show up in the RX FIFO well within this, after they happened
+static constexpr uint64_t RESET_SETTLE_US { 2 };
+
+// Delay field of an instruction, with ".side_set 1 opt" taking the top two bits
+static constexpr uint16_t PIO_DELAY_MASK { 0x0700 };
+
+// Where each reader program keeps its tunable delays, and where it starts from
+struct ReaderLayout {
+    const pio_program_t* program;
+    uint captureAt;
+    uint muxWaitAt;
+    uint startAt;
+    pio_sm_config (*config)(uint offset);
+};
+static constexpr std::array<ReaderLayout, 4> READER_LAYOUTS { {
+    { &Bus_FilteredRead_program, Bus_FilteredRead_offset_capture, Bus_FilteredRead_offset_mux_wait, 0,
+        &Bus_FilteredRead_program_get_default_config },
+    { &Bus_FastRead_program, Bus_FastRead_offset_capture, Bus_FastRead_offset_mux_wait, Bus_FastRead_offset_idle,
+        &Bus_FastRead_program_get_default_config },
+    { &Bus_PingPong_program, Bus_PingPong_offset_capture, Bus_PingPong_offset_mux_wait, Bus_PingPong_offset_idle,
+        &Bus_PingPong_program_get_default_config },
+    { &Bus_TimingRead_program, Bus_TimingRead_offset_capture, Bus_TimingRead_offset_mux_wait, Bus_TimingRead_offset_idle,
+        &Bus_TimingRead_program_get_default_config },
+} };
+
+// Block completions, for all lanes
+static constexpr uint CAPTURE_DMA_IRQ { DMA_IRQ_1 };
+
+// How long the capture loop sleeps before checking a partially filled DMA block
+static constexpr uint64_t DMA_FLUSH_US { 10000 };
+
+// Bus idle time before the flash log erases ahead, longer than a burst of POST codes usually pauses
+static constexpr uint64_t FLASHLOG_QUIET_US { 20000 };
+
+// Shortest activity LED toggle period for busy readers, anything faster just looks lit
+static constexpr uint64_t LED_BLINK_US { 25000 };
+
+// Bus_ClockMeter windows, long enough for a few ppm with 2 PIO cycles of slack at each end
+static constexpr uint32_t BCLK_WINDOW_PERIODS { 1u << 20 };
+// Without a result in this long, BCLK is reported as stopped
+static constexpr uint64_t BCLK_TIMEOUT_US { 500000 };
+
+// Quiet time after which a run of repeated writes gets reported, even if it may still go on
+static constexpr uint64_t REPEAT_HOLD_US { 100000 };
 
 Logic::Logic()
 {
     s_instance = this;
+    m_timing = IOR_DEFAULT_TIMING;
     SetQuitFlag(false);
     m_appRunning = false;
 }
@@ -26,97 +97,643 @@ void Logic::Stop()
     SetQuitFlag(false);
 }
 
-void Logic::AddressReader(queue_t* list, bool newPcb, const uint16_t baseAddress)
+void Logic::AddressReader(EventRing* list, bool newPcb, const uint16_t baseAddress, const CaptureEngine engine)
+{
+    if (baseAddress == AllAddresses) {
+        m_filter.Fill();
+    } else {
+        m_filter.Clear();
+        m_filter.Add(baseAddress);
+    }
+    RunAddressReader(list, newPcb, engine);
+}
+
+void Logic::AddressReader(EventRing* list, bool newPcb, const PortFilter& filter, const CaptureEngine engine)
+{
+    m_filter = filter;
+    RunAddressReader(list, newPcb, engine);
+}
+
+void Logic::AddressReader(EventRing* list, bool newPcb, std::span<const uint16_t> ports, const CaptureEngine engine)
+{
+    m_filter.Clear();
+    for (const uint16_t port : ports) {
+        m_filter.Add(port);
+    }
+    RunAddressReader(list, newPcb, engine);
+}
+
+void Logic::DeepCapture(EventRing* list, bool newPcb)
+{
+    m_filter.Clear();
+    m_filter.Add(0x0080);
+    m_recorder = m_deepLog.Start() ? &m_deepLog : nullptr;
+    RunAddressReader(list, newPcb, CaptureEngine::Interrupt);
+}
+
+Logic::DeepLog& Logic::GetDeepLog()
+{
+    return m_deepLog;
+}
+
+void Logic::RunAddressReader(EventRing* list, bool newPcb, const CaptureEngine engine)
 {
     if (m_appRunning) {
         panic("Someone forgot to initialize some stuff...");
     }
 
     m_appRunning = true;
+    m_events = list;
+    m_losses.pioStalls = 0;
+    m_losses.captureBuffer = 0;
+    m_losses.eventRing = 0;
+    m_losses.pendingLost = 0;
+    m_losses.pendingStages = LS_None;
+    m_repeats = {};
+    m_trigger.Rearm();
+    m_triggerState = m_trigger.Empty() ? TriggerState::Off : TriggerState::Armed;
 
     // Configure PIO
+    // Single port readers let the PIO do the address matching, bus dump takes
+    // everything, anything in between gets checked against the bitmap
+    const auto singlePort = m_filter.Single();
+    const bool pioFilter = singlePort.has_value();
+    const uint16_t baseAddress = singlePort.value_or(AllAddresses);
+    m_pioMap.useBitmap = !pioFilter && (m_filter.Count() != PortFilter::c_ports);
+    const bool pingPong = !pioFilter && m_pingPong;
+    const BusTiming timing = m_timing;
+    const ReaderProgram reader = pioFilter
+        ? ReaderProgram::FilteredRead
+        : (pingPong ? ReaderProgram::PingPong : ReaderProgram::FastRead);
+    StartBusReader(reader, baseAddress, timing);
+    m_turn = 0;
+    for (uint lane = 0; lane < c_maxLanes; lane++) {
+        m_laneStamp[lane] = 0;
+        m_laneSkip[lane] = 0;
+        m_blockRing[lane].Reset();
+    }
+
+    // Single port readers see a handful of POST codes, let each one blink
+    const PortMatch match = pioFilter ? PortMatch::Pio : (m_pioMap.useBitmap ? PortMatch::Bitmap : PortMatch::Any);
+    const LedBlink blink = pioFilter ? LedBlink::PerEvent : LedBlink::RateLimited;
+    m_captureHandler = SelectCaptureHandler(engine, match, blink);
+    if (engine == CaptureEngine::Dma) {
+        StartDmaCapture();
+    } else if (engine == CaptureEngine::Interrupt) {
+        irq_set_enabled(m_pioMap.pioIrq, false);
+        irq_set_priority(m_pioMap.pioIrq, PICO_HIGHEST_IRQ_PRIORITY + 5);
+        for (uint lane = 0; lane < m_pioMap.lanes; lane++) {
+            pio_set_irq0_source_enabled(m_pioMap.hwBase,
+                pio_get_rx_fifo_not_empty_interrupt_source(m_pioMap.LaneSm(lane)), true);
+        }
+        irq_set_exclusive_handler(m_pioMap.pioIrq, m_captureHandler);
+    }
+
+    m_lastEvent = CaptureClock::FromMicros(time_us_64());
+
+    m_resetPin = newPcb ? PIN_ISA_RST_R6 : PIN_ISA_RST_R5;
+    gpio_init(m_resetPin);
+    gpio_set_dir(m_resetPin, GPIO_IN);
+    gpio_pull_down(m_resetPin);
+    StartResetWatch(timing);
+    if (engine == CaptureEngine::Interrupt) {
+        pio_set_irq0_source_enabled(m_pioMap.hwBase,
+            pio_get_rx_fifo_not_empty_interrupt_source(m_pioMap.resetSm), true);
+    }
+
+    // All counters start together, from the same time
+    const uint64_t startUs = time_us_64();
+    m_clock.Start(startUs, timing.TickQ16(REQ_CLOCK_KHZ), pingPong ? timing.PingPongStallTicks() : timing.StallTicks());
+    m_resetClock.Start(startUs, timing.TickQ16(REQ_CLOCK_KHZ), Reset_Watch_RESET_STALL_TICKS);
+    pio_enable_sm_mask_in_sync(m_pioMap.hwBase, m_pioMap.LaneMask() | (1u << m_pioMap.resetSm));
+    if (engine == CaptureEngine::Interrupt)
+        irq_set_enabled(m_pioMap.pioIrq, true);
+
+    // Bus_FastRead and Bus_PingPong push a timestamp after each sample
+    const size_t wordsPerEvent = pioFilter ? 1 : 2;
+
+    while (!GetQuitFlag()) {
+        if (engine == CaptureEngine::Polled) {
+            // Only comes back when asked to quit
+            m_captureHandler();
+            continue;
+        }
+
+        if (engine == CaptureEngine::Interrupt) {
+            // ISRs push straight to the ring. On a quiet bus though, nobody
+            // gets to decide on a pending reset edge, so that's done here.
+            best_effort_wfe_or_timeout(make_timeout_time_us(DMA_FLUSH_US));
+            const uint32_t irqState = save_and_disable_interrupts();
+            const uint64_t settled = CaptureClock::FromMicros(time_us_64() - RESET_SETTLE_US);
+            const uint32_t emptyMask = m_pioMap.LaneMask() << PIO_FSTAT_RXEMPTY_LSB;
+            if ((m_pioMap.hwBase->fstat & emptyMask) == emptyMask) {
+                DrainResets(settled);
+                FlushQuietRepeats(settled);
+            }
+            if (m_recorder != nullptr) {
+                // Sectors only get erased ahead between bursts, unless there's
+                // no way around it. Flash operations hold off the ISRs anyway,
+                // the RX FIFO rides out what it can, the rest is a PIO stall.
+                m_recorder->Service(settled >= m_lastEvent + CaptureClock::FromMicros(FLASHLOG_QUIET_US));
+            }
+            restore_interrupts(irqState);
+            continue;
+        }
+
+        // Nothing but this loop queues events with DMA, so no need to mask interrupts
+        CheckCaptureLosses();
+
+        // Anything captured before this has landed by the time the blocks are peeked
+        const uint64_t settled = CaptureClock::FromMicros(time_us_64() - RESET_SETTLE_US);
+        std::span<const AddressDecoding::SourceType> blocks[c_maxLanes] {};
+        size_t used[c_maxLanes] {};
+        for (uint lane = 0; lane < m_pioMap.lanes; lane++) {
+            blocks[lane] = PeekDmaCapture(lane);
+            if (!blocks[lane].empty()) {
+                CheckBlockLosses(lane, wordsPerEvent);
+            }
+        }
+
+        // Blocks hold a whole number of events, but the in-flight one may
+        // end between a sample and its timestamp. That one waits for later.
+        // Lanes take turns on the bus, so they're read in turn too.
+        const uint64_t now = time_us_64();
+        size_t consumed = 0;
+        bool queued = false;
+        while (true) {
+            const uint lane = m_turn;
+            if (m_laneSkip[lane] > 0) {
+                // Lost to an overrun, the other lane's events still go in between
+                m_laneSkip[lane]--;
+                m_clock.Skip(1);
+                m_turn = (m_turn + 1) % m_pioMap.lanes;
+                continue;
+            }
+            if (used[lane] + wordsPerEvent > blocks[lane].size()) {
+                break;
+            }
+            const auto* words = &blocks[lane][used[lane]];
+            used[lane] += wordsPerEvent;
+            consumed++;
+
+            const auto busData = pioFilter
+                ? AddressDecoding::ParseFilteredRead(words[0], baseAddress)
+                : AddressDecoding::ParseBusRead(words[0]);
+            // Bus_FilteredRead carries no timestamp, drain time is the best we have here
+            const uint64_t when = pioFilter
+                ? CaptureClock::FromMicros(now)
+                : ResolveStamp(words[1], now);
+            if (m_pioMap.useBitmap && !m_filter.Test(busData.Address())) {
+                continue;
+            }
+            queued = true;
+
+            // Wait for the UI to catch up, unless we're being asked to quit.
+            // A few slots, in case a gap marker or reset markers have to go first.
+            // With a trigger set, the UI holds on to events on purpose, so no waiting then.
+            while (m_policy.load(std::memory_order_relaxed) == OverflowPolicy::Lossless
+                && m_triggerState.load(std::memory_order_relaxed) == TriggerState::Off
+                && m_events->Free() < 4 && !GetQuitFlag()) {
+                tight_loop_contents();
+            }
+
+            DrainResets(when);
+            EmitEvent(when, {
+                .address = busData.Address(),
+                .data = busData.data,
+                .operation = QueueOperation::P80Data,
+            });
+        }
+        for (uint lane = 0; lane < m_pioMap.lanes; lane++) {
+            m_blockRing[lane].Release(used[lane]);
+        }
+        if (queued) {
+            BlinkActivity(now);
+        }
+
+        if (consumed == 0) {
+            // Nothing new: sleep until the next block completes, or until a
+            // partial block is worth flushing
+            DrainResets(settled);
+            FlushQuietRepeats(settled);
+            best_effort_wfe_or_timeout(make_timeout_time_us(DMA_FLUSH_US));
+        }
+    }
+
+    pio_set_sm_mask_enabled(m_pioMap.hwBase, m_pioMap.LaneMask(), false);
+    if (engine == CaptureEngine::Dma) {
+        StopDmaCapture();
+    } else if (engine == CaptureEngine::Interrupt) {
+        irq_set_enabled(m_pioMap.pioIrq, false);
+        for (uint lane = 0; lane < m_pioMap.lanes; lane++) {
+            pio_set_irq0_source_enabled(m_pioMap.hwBase,
+                pio_get_rx_fifo_not_empty_interrupt_source(m_pioMap.LaneSm(lane)), false);
+        }
+        pio_set_irq0_source_enabled(m_pioMap.hwBase,
+            pio_get_rx_fifo_not_empty_interrupt_source(m_pioMap.resetSm), false);
+    }
+    FlushRepeats();
+    StopResetWatch();
+    if (engine == CaptureEngine::Interrupt) {
+        irq_remove_handler(m_pioMap.pioIrq, m_captureHandler);
+    }
+    m_captureHandler = nullptr;
+    gpio_deinit(m_resetPin);
+    StopBusReader();
+    m_triggerState = TriggerState::Off;
+    if (m_recorder != nullptr) {
+        // Blocks still in RAM go to flash too
+        m_recorder->Finish();
+        m_recorder = nullptr;
+    }
+
+    sleep_ms(100);
+    m_appRunning = false;
+}
+
+void Logic::StartBusReader(ReaderProgram reader, uint16_t baseAddress, const BusTiming& timing)
+{
+    const bool pioFilter = (reader == ReaderProgram::FilteredRead);
+    const bool pingPong = (reader == ReaderProgram::PingPong);
+    const auto& layout = READER_LAYOUTS[static_cast<size_t>(reader)];
+
+    // Patch the mux delays into a copy of the program, then load that
+    const pio_program_t& base = *layout.program;
+    const uint delayAt[2] = { layout.captureAt, layout.muxWaitAt };
+    const uint8_t delays[2] = { timing.FirstDelay(), timing.SecondDelay() };
+    std::copy_n(base.instructions, base.length, m_programCode.begin());
+    for (uint idx = 0; idx < 2; idx++) {
+        m_programCode[delayAt[idx]] = static_cast<uint16_t>(
+            (m_programCode[delayAt[idx]] & ~PIO_DELAY_MASK) | pio_encode_delay(delays[idx]));
+    }
+    m_program = base;
+    m_program.instructions = m_programCode.data();
+
     m_pioMap.hwBase = pio0;
-    m_pioMap.readerOffset = pio_add_program(m_pioMap.hwBase, &Bus_FastRead_program);
+    m_pioMap.program = &m_program;
+    m_pioMap.readerOffset = pio_add_program(m_pioMap.hwBase, m_pioMap.program);
     m_pioMap.readerSm = 0;
     pio_sm_claim(m_pioMap.hwBase, m_pioMap.readerSm);
+    // SM1 is taken by Reset_Watch, Bus_PingPong hands over two SMs up
+    m_pioMap.pairSm = pingPong ? 2 : -1;
+    m_pioMap.lanes = pingPong ? 2 : 1;
+    if (pingPong) {
+        pio_sm_claim(m_pioMap.hwBase, m_pioMap.pairSm);
+        // Turn flags may be left over from a previous session
+        pio_interrupt_clear(m_pioMap.hwBase, m_pioMap.readerSm);
+        pio_interrupt_clear(m_pioMap.hwBase, m_pioMap.pairSm);
+    }
     m_pioMap.pioIrq = PIO0_IRQ_0;
-    m_pioMap.rstIrq = IO_IRQ_BANK0;
     m_pioMap.filterAddress = baseAddress;
 
     pio_gpio_init(m_pioMap.hwBase, PIN_ADDRESS_BANK);
     pio_sm_set_consecutive_pindirs(m_pioMap.hwBase, m_pioMap.readerSm, PIN_ADDRESS_BANK, 1, true);
     pio_sm_set_consecutive_pindirs(m_pioMap.hwBase, m_pioMap.readerSm, PIN_ISA_D0, 16, false);
-    pio_sm_config pioCfg = Bus_FastRead_program_get_default_config(m_pioMap.readerOffset);
+    pio_sm_config pioCfg = layout.config(m_pioMap.readerOffset);
     sm_config_set_sideset_pins(&pioCfg, PIN_ADDRESS_BANK);
-    sm_config_set_in_pins(&pioCfg, PIN_ISA_D0);
+    if (pioFilter) {
+        // TX FIFO is needed to load the target address, so no RX join here
+        sm_config_set_in_pins(&pioCfg, PIN_ISA_A0);
+    } else {
+        sm_config_set_in_pins(&pioCfg, PIN_ISA_D0);
+        sm_config_set_jmp_pin(&pioCfg, PIN_ISA_BRDY);
+        sm_config_set_fifo_join(&pioCfg, PIO_FIFO_JOIN_RX);
+    }
     sm_config_set_in_shift(&pioCfg, true, true, 32);
-    sm_config_set_fifo_join(&pioCfg, PIO_FIFO_JOIN_RX);
-    if (IOR_CLKDIV > 1.f)
-        sm_config_set_clkdiv(&pioCfg, IOR_CLKDIV);
-    pio_sm_init(m_pioMap.hwBase, m_pioMap.readerSm, m_pioMap.readerOffset, &pioCfg);
+    sm_config_set_clkdiv_int_frac(&pioCfg, timing.clkDiv256 >> 8, timing.clkDiv256 & 0xFF);
+    pio_sm_init(m_pioMap.hwBase, m_pioMap.readerSm, m_pioMap.readerOffset + layout.startAt, &pioCfg);
     pio_sm_clear_fifos(m_pioMap.hwBase, m_pioMap.readerSm);
+    if (pioFilter) {
+        pio_sm_put(m_pioMap.hwBase, m_pioMap.readerSm, static_cast<uint32_t>(baseAddress) << 16);
+    } else {
+        // Timestamp counter starts from zero
+        pio_sm_exec(m_pioMap.hwBase, m_pioMap.readerSm, pio_encode_set(pio_x, 0));
+    }
 
-    irq_set_enabled(m_pioMap.pioIrq, false);
-    irq_set_priority(m_pioMap.pioIrq, PICO_HIGHEST_IRQ_PRIORITY + 5);
-    pio_set_irq0_source_enabled(m_pioMap.hwBase, pis_sm0_rx_fifo_not_empty, true);
-    if (baseAddress == AllAddresses)
-        irq_set_exclusive_handler(m_pioMap.pioIrq, &Logic::BusReaderNoFilterISR);
-    else
-        irq_set_exclusive_handler(m_pioMap.pioIrq, &Logic::BusReaderISR);
+    if (pingPong) {
+        // Same setup, but it waits for its first turn
+        pio_sm_init(m_pioMap.hwBase, m_pioMap.pairSm, m_pioMap.readerOffset + Bus_PingPong_offset_standby, &pioCfg);
+        pio_sm_clear_fifos(m_pioMap.hwBase, m_pioMap.pairSm);
+        pio_sm_exec(m_pioMap.hwBase, m_pioMap.pairSm, pio_encode_set(pio_x, 0));
+    }
+}
 
-    m_lastReset = time_us_64();
+void Logic::StopBusReader()
+{
+    pio_set_sm_mask_enabled(m_pioMap.hwBase, m_pioMap.LaneMask(), false);
+    for (uint lane = 0; lane < m_pioMap.lanes; lane++) {
+        const uint sm = m_pioMap.LaneSm(lane);
+        pio_sm_clear_fifos(m_pioMap.hwBase, sm);
+        pio_sm_restart(m_pioMap.hwBase, sm);
+        pio_sm_unclaim(m_pioMap.hwBase, sm);
+    }
+    pio_remove_program(m_pioMap.hwBase, m_pioMap.program, m_pioMap.readerOffset);
+    m_pioMap.program = nullptr;
+    m_pioMap.readerSm = -1;
+    m_pioMap.pairSm = -1;
+    m_pioMap.lanes = 1;
+    m_pioMap.readerOffset = 0;
+}
 
-    m_resetPin = newPcb ? PIN_ISA_RST_R6 : PIN_ISA_RST_R5;
-    gpio_init(m_resetPin);
-    gpio_set_dir(m_resetPin, GPIO_IN);
-    gpio_pull_down(m_resetPin);
+void Logic::StartResetWatch(const BusTiming& timing)
+{
+    m_reset = {};
+    m_pioMap.resetOffset = pio_add_program(m_pioMap.hwBase, &Reset_Watch_program);
+    m_pioMap.resetSm = 1;
+    pio_sm_claim(m_pioMap.hwBase, m_pioMap.resetSm);
+
+    pio_sm_config pioCfg = Reset_Watch_program_get_default_config(m_pioMap.resetOffset);
+    sm_config_set_jmp_pin(&pioCfg, m_resetPin);
+    sm_config_set_fifo_join(&pioCfg, PIO_FIFO_JOIN_RX);
+    sm_config_set_in_shift(&pioCfg, true, true, 32);
+    // Same clock as the reader, so both counters tick together
+    sm_config_set_clkdiv_int_frac(&pioCfg, timing.clkDiv256 >> 8, timing.clkDiv256 & 0xFF);
+    pio_sm_init(m_pioMap.hwBase, m_pioMap.resetSm, m_pioMap.resetOffset + Reset_Watch_offset_idle, &pioCfg);
+    pio_sm_clear_fifos(m_pioMap.hwBase, m_pioMap.resetSm);
+    pio_sm_exec(m_pioMap.hwBase, m_pioMap.resetSm, pio_encode_set(pio_x, 0));
+}
+
+void Logic::StopResetWatch()
+{
+    pio_sm_set_enabled(m_pioMap.hwBase, m_pioMap.resetSm, false);
+    pio_sm_clear_fifos(m_pioMap.hwBase, m_pioMap.resetSm);
+    pio_sm_restart(m_pioMap.hwBase, m_pioMap.resetSm);
+    pio_sm_unclaim(m_pioMap.hwBase, m_pioMap.resetSm);
+    pio_remove_program(m_pioMap.hwBase, &Reset_Watch_program, m_pioMap.resetOffset);
+    m_pioMap.resetSm = -1;
+    m_pioMap.resetOffset = 0;
+}
+
+void __not_in_flash_func(Logic::DrainResets)(uint64_t until)
+{
+    auto& reset = m_reset;
+    while (true) {
+        if (!reset.haveNext) {
+            if (m_pioMap.hwBase->fstat & (1u << (PIO_FSTAT_RXEMPTY_LSB + m_pioMap.resetSm))) {
+                break;
+            }
+            reset.next = m_resetClock.Resolve(m_pioMap.hwBase->rxf[m_pioMap.resetSm], time_us_64());
+            reset.haveNext = true;
+        }
+
+        // Edges later than that wait, there may be bus cycles before them still to come
+        if (reset.next > until) {
+            break;
+        }
+        reset.haveNext = false;
+        FeedResetEdge(reset.next);
+    }
+    SettleReset(until);
+}
+
+void __not_in_flash_func(Logic::FeedResetEdge)(uint64_t when)
+{
+    auto& reset = m_reset;
+    const uint64_t minWidth = CaptureClock::FromMicros(RESET_MIN_US);
+
+    // Reset_Watch pushes rising and falling edges in turn, the stage tells which one this is
+    switch (reset.stage) {
+    case ResetStage::Inactive: {
+        reset.riseAt = when;
+        reset.stage = ResetStage::DebounceActive;
+    } break;
+
+    case ResetStage::DebounceActive: {
+        if (when - reset.riseAt < minWidth) {
+            // Glitch, never happened
+            reset.stage = ResetStage::Inactive;
+        } else {
+            EmitEvent(reset.riseAt, { .operation = QueueOperation::P80ResetActive });
+            reset.fallAt = when;
+            reset.stage = ResetStage::DebounceInactive;
+        }
+    } break;
+
+    case ResetStage::Active: {
+        reset.fallAt = when;
+        reset.stage = ResetStage::DebounceInactive;
+    } break;
+
+    case ResetStage::DebounceInactive: {
+        if (when - reset.fallAt < minWidth) {
+            // Dropout, reset is still being held
+            reset.stage = ResetStage::Active;
+        } else {
+            SettleReset(reset.fallAt + minWidth);
+            reset.riseAt = when;
+            reset.stage = ResetStage::DebounceActive;
+        }
+    } break;
+    }
+}
+
+void __not_in_flash_func(Logic::SettleReset)(uint64_t until)
+{
+    auto& reset = m_reset;
+    const uint64_t minWidth = CaptureClock::FromMicros(RESET_MIN_US);
+
+    if (reset.stage == ResetStage::DebounceActive && until >= reset.riseAt + minWidth) {
+        EmitEvent(reset.riseAt, { .operation = QueueOperation::P80ResetActive });
+        reset.stage = ResetStage::Active;
+    } else if (reset.stage == ResetStage::DebounceInactive && until >= reset.fallAt + minWidth) {
+        // Pulse width goes along, in us, split across address and data
+        const uint32_t width = static_cast<uint32_t>(
+            std::min<uint64_t>(CaptureClock::ToMicros(reset.fallAt - reset.riseAt), c_maxPulseWidth));
+        EmitEvent(reset.fallAt, {
+            .address = static_cast<uint16_t>(width & 0xFFFF),
+            .data = static_cast<uint8_t>(width >> 16),
+            .operation = QueueOperation::P80ResetCleared,
+        });
+        reset.stage = ResetStage::Inactive;
+    }
+}
+
+void Logic::CalibrateTiming(EventRing* list)
+{
+    if (m_appRunning) {
+        panic("Someone forgot to initialize some stuff...");
+    }
+
+    m_appRunning = true;
+    m_events = list;
+
+    // Ports seen with safe timings are the reference for everything else
+    auto seen = std::make_unique<PortFilter>();
+    ProbeTiming(IOR_DEFAULT_TIMING, *seen, true);
+
+    BusTiming best {};
+    uint32_t bestNs = UINT32_MAX;
+    for (const auto divider : IOR_CALIB_DIVIDERS) {
+        for (uint8_t muxDelay = BusTiming::c_maxMuxDelay; !GetQuitFlag(); muxDelay -= 2) {
+            const BusTiming timing { .clkDiv256 = divider, .muxDelay = muxDelay };
+            const auto probe = ProbeTiming(timing, *seen, false);
+            const uint32_t errors = probe.tornData + probe.strayAddress;
+            const uint32_t deadNs = timing.DeadTimeNs(REQ_CLOCK_KHZ);
+
+            const bool quiet = (probe.samples < IOR_CALIB_MIN_SAMPLES);
+            m_events->Push({
+                .address = static_cast<uint16_t>(std::min<uint32_t>(deadNs, UINT16_MAX)),
+                .data = quiet ? c_calibNoTraffic : static_cast<uint8_t>(std::min<uint32_t>(errors, c_calibNoTraffic - 1)),
+                .operation = QueueOperation::CalibrationStep,
+            });
+            if (!quiet && errors == 0 && deadNs < bestNs) {
+                best = timing;
+                bestNs = deadNs;
+            }
+
+            if (muxDelay == 0) {
+                break;
+            }
+        }
+    }
 
-    irq_set_enabled(m_pioMap.rstIrq, false);
-    irq_set_priority(m_pioMap.rstIrq, PICO_HIGHEST_IRQ_PRIORITY + 5);
-    gpio_set_irq_enabled_with_callback(m_resetPin, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true, &Logic::ResetPulseISR);
+    if (!GetQuitFlag()) {
+        const bool found = (bestNs != UINT32_MAX);
+        if (found) {
+            m_timing = best;
+        }
+        m_events->Push({
+            .address = static_cast<uint16_t>(found ? std::min<uint32_t>(bestNs, UINT16_MAX) : 0),
+            .operation = QueueOperation::CalibrationDone,
+        });
+    }
+
+    // Results stay on screen until the user goes back
+    while (!GetQuitFlag()) {
+        sleep_ms(10);
+    }
+
+    m_appRunning = false;
+}
+
+void Logic::CycleTiming()
+{
+    if (m_appRunning) {
+        panic("Someone forgot to initialize some stuff...");
+    }
+
+    m_appRunning = true;
+    m_cycleStats.Clear();
+    const BusTiming timing = m_timing;
+    StartBusReader(ReaderProgram::TimingRead, AllAddresses, timing);
     pio_sm_set_enabled(m_pioMap.hwBase, m_pioMap.readerSm, true);
-    irq_set_enabled(m_pioMap.pioIrq, true);
-    QueueData qd;
+
+    // Polled, core 1 has nothing else to do meanwhile
+    const PIO pio = m_pioMap.hwBase;
+    const uint sm = m_pioMap.readerSm;
+    const uint32_t stallMask = 1u << (PIO_FDEBUG_RXSTALL_LSB + sm);
+    pio->fdebug = stallMask;
+    uint32_t lastFall = 0;
+    bool haveLast = false;
     while (!GetQuitFlag()) {
-        if (auto newData = m_ringBuffer.pop()) {
-            const auto& entry = newData.value();
-            if (entry.type == TimelineEntry::Type::Data) {
-                qd.address = entry.busData.Address();
-                qd.operation = QueueOperation::P80Data;
-                qd.timestamp = time_us_64() - m_lastReset;
-                qd.data = entry.busData.data;
-            } else if (entry.type == TimelineEntry::Type::Reset) {
-                m_lastReset = time_us_64();
-                qd.address = 0;
-                qd.data = 0;
-                qd.operation = entry.resetEvent;
-                qd.timestamp = m_lastReset;
-            }
-            queue_add_blocking(list, &qd);
+        if (pio->fdebug & stallMask) {
+            // Counter stood still for a while, the quiet time before the next cycle can't be told
+            pio->fdebug = stallMask;
+            m_cycleStats.AddStall();
+            haveLast = false;
+        }
+        if (pio_sm_get_rx_fifo_level(pio, sm) < 3) {
+            tight_loop_contents();
+            continue;
         }
+
+        const auto busData = AddressDecoding::ParseBusRead(pio_sm_get(pio, sm));
+        const uint32_t rise = pio_sm_get(pio, sm);
+        const uint32_t fall = pio_sm_get(pio, sm);
+
+        // See Bus_TimingRead for where these come from
+        const uint64_t widthCycles = 2ull * (rise - fall) + BusTiming::c_captureCycles + timing.muxDelay;
+        const uint32_t gapNs = haveLast ? timing.CyclesToNs(2ull * (lastFall - rise), REQ_CLOCK_KHZ) : CycleStats::c_noGap;
+        m_cycleStats.Add(busData.Address(), timing.CyclesToNs(widthCycles, REQ_CLOCK_KHZ), gapNs);
+        lastFall = fall;
+        haveLast = true;
     }
 
-    pio_sm_set_enabled(m_pioMap.hwBase, m_pioMap.readerSm, false);
-    irq_set_enabled(m_pioMap.pioIrq, false);
-    pio_set_irq0_source_enabled(m_pioMap.hwBase, pis_sm0_rx_fifo_not_empty, false);
-    irq_set_enabled(m_pioMap.rstIrq, false);
-    gpio_set_irq_enabled_with_callback(m_resetPin, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, false, nullptr);
-    pio_sm_clear_fifos(m_pioMap.hwBase, m_pioMap.readerSm);
-    pio_sm_restart(m_pioMap.hwBase, m_pioMap.readerSm);
-    pio_sm_unclaim(m_pioMap.hwBase, m_pioMap.readerSm);
-    if (baseAddress == AllAddresses)
-        irq_remove_handler(m_pioMap.pioIrq, &Logic::BusReaderNoFilterISR);
-    else
-        irq_remove_handler(m_pioMap.pioIrq, &Logic::BusReaderISR);
-    gpio_deinit(m_resetPin);
-    pio_remove_program(m_pioMap.hwBase, &Bus_FastRead_program, m_pioMap.readerOffset);
-    m_pioMap.readerSm = -1;
-    m_pioMap.readerOffset = 0;
+    StopBusReader();
+    m_appRunning = false;
+}
 
-    sleep_ms(100);
+void Logic::GetCycleStats(CycleStats& stats) const
+{
+    stats = m_cycleStats;
+}
+
+void Logic::PortInventory()
+{
+    if (m_appRunning) {
+        panic("Someone forgot to initialize some stuff...");
+    }
+
+    m_appRunning = true;
+    m_heatmap.Clear();
+    const BusTiming timing = m_timing;
+    StartBusReader(ReaderProgram::FastRead, AllAddresses, timing);
+    pio_sm_set_enabled(m_pioMap.hwBase, m_pioMap.readerSm, true);
+
+    const PIO pio = m_pioMap.hwBase;
+    const uint sm = m_pioMap.readerSm;
+    const uint32_t stallMask = 1u << (PIO_FDEBUG_RXSTALL_LSB + sm);
+    pio->fdebug = stallMask;
+    while (!GetQuitFlag()) {
+        if (pio->fdebug & stallMask) {
+            pio->fdebug = stallMask;
+            m_heatmap.AddStall();
+        }
+        if (pio_sm_get_rx_fifo_level(pio, sm) < 2) {
+            tight_loop_contents();
+            continue;
+        }
+
+        const auto busData = AddressDecoding::ParseBusRead(pio_sm_get(pio, sm));
+        pio_sm_get(pio, sm); // Timestamp, not needed here
+        m_heatmap.Add(busData.Address());
+    }
+
+    StopBusReader();
     m_appRunning = false;
 }
 
+void Logic::GetHeatmap(PortHeatmap& heatmap) const
+{
+    heatmap = m_heatmap;
+}
+
+BusTiming Logic::GetBusTiming() const
+{
+    return m_timing;
+}
+
+Logic::TimingProbe Logic::ProbeTiming(const BusTiming& timing, PortFilter& seen, bool learn)
+{
+    TimingProbe probe {};
+    StartBusReader(ReaderProgram::FastRead, AllAddresses, timing);
+    pio_sm_set_enabled(m_pioMap.hwBase, m_pioMap.readerSm, true);
+
+    // Polled, no need for interrupts or DMA here
+    const uint64_t deadline = time_us_64() + (learn ? IOR_CALIB_BASELINE_US : IOR_CALIB_STEP_US);
+    const uint32_t target = learn ? UINT32_MAX : IOR_CALIB_SAMPLES;
+    while (probe.samples < target && time_us_64() < deadline && !GetQuitFlag()) {
+        if (pio_sm_get_rx_fifo_level(m_pioMap.hwBase, m_pioMap.readerSm) < 2) {
+            tight_loop_contents();
+            continue;
+        }
+        const auto busData = AddressDecoding::ParseBusRead(pio_sm_get(m_pioMap.hwBase, m_pioMap.readerSm));
+        pio_sm_get(m_pioMap.hwBase, m_pioMap.readerSm); // Timestamp, not needed here
+        probe.samples++;
+
+        if (busData.dataCopy != busData.data) {
+            probe.tornData++;
+        } else if (learn) {
+            seen.Add(busData.Address());
+        } else if (!seen.Test(busData.Address())) {
+            probe.strayAddress++;
+        }
+    }
+
+    StopBusReader();
+    return probe;
+}
+
 void Logic::VoltageMonitor(queue_t* list)
 {
     if (m_appRunning) {
@@ -132,9 +749,7 @@ void Logic::VoltageMonitor(queue_t* list)
         m_volts = std::make_unique<VoltMon>();
     }
 
-    QueueData qd = {
-        .operation = QueueOperation::Volts
-    };
+    VoltageSample vs {};
     m_lastReset = time_us_64();
 
     double readFive = 0.0;
@@ -147,10 +762,10 @@ void Logic::VoltageMonitor(queue_t* list)
             readTwelve = m_volts->Read12();
 
             uint64_t tstamp = time_us_64() - m_lastReset;
-            qd.timestamp = tstamp;
-            qd.volts5 = static_cast<float>(readFive);
-            qd.volts12 = static_cast<float>(readTwelve);
-            queue_try_add(list, &qd);
+            vs.timestamp = tstamp;
+            vs.volts5 = static_cast<float>(readFive);
+            vs.volts12 = static_cast<float>(readTwelve);
+            queue_try_add(list, &vs);
 
             readerDelay = time_us_64() + 100000; // 100ms read delay
         } else {
@@ -163,55 +778,563 @@ void Logic::VoltageMonitor(queue_t* list)
     m_appRunning = false;
 }
 
+void Logic::ClockMeter(queue_t* list, bool newPcb)
+{
+    if (m_appRunning) {
+        panic("Someone forgot to initialize some stuff...");
+    }
+
+    m_appRunning = true;
+    m_busClockHz = 0;
+    if (!newPcb) {
+        // Nothing to measure on rev 5, BCLK doesn't get here
+        while (!GetQuitFlag()) {
+            sleep_ms(15);
+        }
+        m_appRunning = false;
+        return;
+    }
+
+    gpio_init(PIN_ISA_CLK_R6);
+    gpio_set_dir(PIN_ISA_CLK_R6, GPIO_IN);
+
+    // SM0 times long windows, SM1 single periods
+    const PIO pio = pio0;
+    const uint offset = pio_add_program(pio, &Bus_ClockMeter_program);
+    const uint freqSm = 0;
+    const uint periodSm = 1;
+    for (const uint sm : { freqSm, periodSm }) {
+        pio_sm_claim(pio, sm);
+        pio_sm_config pioCfg = Bus_ClockMeter_program_get_default_config(offset);
+        sm_config_set_jmp_pin(&pioCfg, PIN_ISA_CLK_R6);
+        sm_config_set_in_shift(&pioCfg, false, false, 32);
+        sm_config_set_clkdiv_int_frac(&pioCfg, 1, 0);
+        pio_sm_init(pio, sm, offset + Bus_ClockMeter_offset_sync, &pioCfg);
+        pio_sm_put(pio, sm, (sm == freqSm ? BCLK_WINDOW_PERIODS : 1) - 1);
+        pio_sm_exec(pio, sm, pio_encode_pull(false, true));
+    }
+    pio_enable_sm_mask_in_sync(pio, (1u << freqSm) | (1u << periodSm));
+
+    // PIO cycles for a window, see Bus_ClockMeter
+    auto windowCycles = [](uint32_t raw, uint32_t periods) {
+        return 2ull * (static_cast<uint32_t>(~raw) + periods + Bus_ClockMeter_CLOCK_METER_OVERHEAD);
+    };
+    auto cyclesToNs = [](uint64_t cycles) {
+        return static_cast<uint16_t>(std::min<uint64_t>(cycles * 1000000 / REQ_CLOCK_KHZ, UINT16_MAX));
+    };
+
+    ClockSample cs {};
+    m_lastReset = time_us_64();
+    uint64_t minCycles = UINT64_MAX;
+    uint64_t maxCycles = 0;
+    uint64_t lastReport = time_us_64();
+
+    while (!GetQuitFlag()) {
+        // Single periods come in way faster than they can be read, any of them will do
+        while (!pio_sm_is_rx_fifo_empty(pio, periodSm)) {
+            const uint64_t cycles = windowCycles(pio_sm_get(pio, periodSm), 1);
+            minCycles = std::min(minCycles, cycles);
+            maxCycles = std::max(maxCycles, cycles);
+        }
+
+        const uint64_t now = time_us_64();
+        if (!pio_sm_is_rx_fifo_empty(pio, freqSm)) {
+            const uint64_t cycles = windowCycles(pio_sm_get(pio, freqSm), BCLK_WINDOW_PERIODS);
+            cs.frequencyHz = static_cast<uint32_t>(
+                (BCLK_WINDOW_PERIODS * static_cast<uint64_t>(REQ_CLOCK_KHZ) * 1000 + cycles / 2) / cycles);
+        } else if (now - lastReport >= BCLK_TIMEOUT_US) {
+            cs.frequencyHz = 0;
+        } else {
+            continue;
+        }
+
+        cs.timestamp = now - m_lastReset;
+        cs.minPeriodNs = (maxCycles > 0) ? cyclesToNs(minCycles) : 0;
+        cs.maxPeriodNs = (maxCycles > 0) ? cyclesToNs(maxCycles) : 0;
+        queue_try_add(list, &cs);
+        m_busClockHz = cs.frequencyHz;
+
+        minCycles = UINT64_MAX;
+        maxCycles = 0;
+        lastReport = now;
+    }
+
+    pio_set_sm_mask_enabled(pio, (1u << freqSm) | (1u << periodSm), false);
+    for (const uint sm : { freqSm, periodSm }) {
+        pio_sm_clear_fifos(pio, sm);
+        pio_sm_restart(pio, sm);
+        pio_sm_unclaim(pio, sm);
+    }
+    pio_remove_program(pio, &Bus_ClockMeter_program, offset);
+    gpio_deinit(PIN_ISA_CLK_R6);
+
+    m_appRunning = false;
+}
+
+uint32_t Logic::GetBusClock() const
+{
+    return m_busClockHz;
+}
+
+void Logic::SetPingPong(bool enabled)
+{
+    m_pingPong = enabled;
+}
+
+void Logic::SetCoalescing(bool enabled)
+{
+    m_coalesce = enabled;
+}
+
+void Logic::SetOverflowPolicy(OverflowPolicy policy)
+{
+    m_policy = policy;
+}
+
+void Logic::SetTrigger(const TriggerEngine& trigger, uint32_t postEvents)
+{
+    m_trigger = trigger;
+    m_postTrigger = postEvents;
+}
+
+Logic::TriggerState Logic::GetTriggerState() const
+{
+    return m_triggerState;
+}
+
+Logic::CaptureLosses Logic::GetLosses() const
+{
+    return {
+        .pioStalls = m_losses.pioStalls.load(std::memory_order_relaxed),
+        .captureBuffer = m_losses.captureBuffer.load(std::memory_order_relaxed),
+        .eventRing = m_losses.eventRing.load(std::memory_order_relaxed),
+    };
+}
+
+bool __not_in_flash_func(Logic::EmitEvent)(uint64_t when, BusEvent event)
+{
+    const auto triggerState = m_triggerState.load(std::memory_order_relaxed);
+    if (triggerState == TriggerState::Frozen) {
+        // Post-trigger window is complete, nothing else goes in
+        return true;
+    }
+
+    auto& run = m_repeats;
+    if (run.open && event.operation == QueueOperation::P80Data && event.address == run.address
+        && event.data == run.data && m_losses.pendingStages == LS_None
+        && m_coalesce.load(std::memory_order_relaxed)) {
+        run.count++;
+        run.lastAt = when;
+        if (run.count == UINT16_MAX) {
+            // As many as a P80Repeat can tell, the run goes on in a new one
+            FlushRepeats();
+        }
+        if (triggerState != TriggerState::Off) {
+            UpdateTrigger(when, event);
+        }
+        return true;
+    }
+
+    // Anything else ends the run
+    FlushRepeats();
+    run.open = false;
+
+    // Let the UI know something went missing right before this event
+    bool queued = true;
+    if (m_losses.pendingStages != LS_None) {
+        const BusEvent gap {
+            .address = static_cast<uint16_t>(std::min<uint32_t>(m_losses.pendingLost, UINT16_MAX)),
+            .data = m_losses.pendingStages,
+            .operation = QueueOperation::P80Gap,
+        };
+        queued = PushEvent(when, gap);
+        if (queued) {
+            m_losses.pendingLost = 0;
+            m_losses.pendingStages = LS_None;
+        }
+    }
+
+    queued = queued && PushEvent(when, event);
+    if (!queued) {
+        m_losses.eventRing.fetch_add(1, std::memory_order_relaxed);
+        MarkGap(LS_EventRing, 1);
+    } else if (event.operation == QueueOperation::P80Data && m_coalesce.load(std::memory_order_relaxed)) {
+        run.open = true;
+        run.address = event.address;
+        run.data = event.data;
+    }
+
+    // Lost or not, the event did happen on the bus
+    if (triggerState != TriggerState::Off) {
+        UpdateTrigger(when, event);
+    }
+
+    return queued;
+}
+
+void __not_in_flash_func(Logic::UpdateTrigger)(uint64_t when, const BusEvent& event)
+{
+    if (m_triggerState == TriggerState::Armed) {
+        if (m_trigger.Feed(event)) {
+            // Marks the spot, right after the event that fired
+            FlushRepeats();
+            PushEvent(when, { .operation = QueueOperation::P80Trigger });
+            m_postLeft = m_postTrigger;
+            m_triggerState = (m_postLeft == 0) ? TriggerState::Frozen : TriggerState::Triggered;
+        }
+    } else if (m_triggerState == TriggerState::Triggered) {
+        if (--m_postLeft == 0) {
+            FlushRepeats();
+            m_triggerState = TriggerState::Frozen;
+        }
+    }
+}
+
+bool __not_in_flash_func(Logic::PushEvent)(uint64_t when, BusEvent event)
+{
+    // Cycles sampled right before a reset may be handled after it
+    uint64_t delta = (when > m_lastEvent) ? (when - m_lastEvent) : 0;
+
+    // Silences too long for a single delta get split, so the UI clock keeps up
+    while (delta > BusEvent::c_maxDelta) {
+        if (!m_events->Push({ .delta = BusEvent::c_maxDelta })) {
+            return false;
+        }
+        if (m_recorder != nullptr) {
+            m_recorder->Add({ .delta = BusEvent::c_maxDelta });
+        }
+        m_lastEvent += BusEvent::c_maxDelta;
+        delta -= BusEvent::c_maxDelta;
+    }
+
+    event.delta = static_cast<uint32_t>(delta);
+    if (!m_events->Push(event)) {
+        return false;
+    }
+    if (m_recorder != nullptr) {
+        m_recorder->Add(event);
+    }
+    m_lastEvent = std::max(m_lastEvent, when);
+
+    return true;
+}
+
+void __not_in_flash_func(Logic::FlushRepeats)()
+{
+    auto& run = m_repeats;
+    if (run.count == 0) {
+        return;
+    }
+
+    const BusEvent record {
+        .address = static_cast<uint16_t>(run.count),
+        .operation = QueueOperation::P80Repeat,
+    };
+    if (!PushEvent(run.lastAt, record)) {
+        m_losses.eventRing.fetch_add(run.count, std::memory_order_relaxed);
+        MarkGap(LS_EventRing, run.count);
+    }
+    run.count = 0;
+}
+
+void __not_in_flash_func(Logic::FlushQuietRepeats)(uint64_t until)
+{
+    if (m_repeats.count > 0 && until >= m_repeats.lastAt + CaptureClock::FromMicros(REPEAT_HOLD_US)) {
+        FlushRepeats();
+    }
+}
+
+void __not_in_flash_func(Logic::MarkGap)(LossStage stage, uint32_t events)
+{
+    m_losses.pendingStages |= stage;
+    m_losses.pendingLost += events;
+}
+
+uint64_t __not_in_flash_func(Logic::ResolveStamp)(uint32_t stamp, uint64_t nowUs)
+{
+    // Bus_PingPong SMs only count while holding the turn, so the actual
+    // timeline is the sum of both. With a single lane, it's just the stamp.
+    m_laneStamp[m_turn] = stamp;
+    uint32_t merged = 0;
+    for (uint lane = 0; lane < m_pioMap.lanes; lane++) {
+        merged += m_laneStamp[lane];
+    }
+    m_turn = (m_turn + 1) % m_pioMap.lanes;
+
+    return m_clock.Resolve(merged, nowUs);
+}
+
+void __not_in_flash_func(Logic::CheckCaptureLosses)()
+{
+    // RXSTALL is sticky, write 1 to clear. Bus_FastRead's tick counter stood
+    // still during the stall too, so timestamps after this gap run a bit late.
+    const uint32_t stallMask = m_pioMap.LaneMask() << PIO_FDEBUG_RXSTALL_LSB;
+    const uint32_t stalled = m_pioMap.hwBase->fdebug & stallMask;
+    if (stalled) {
+        m_pioMap.hwBase->fdebug = stalled;
+        m_losses.pioStalls.fetch_add(1, std::memory_order_relaxed);
+        MarkGap(LS_PioStall, 0);
+    }
+}
+
+void __not_in_flash_func(Logic::CheckBlockLosses)(uint lane, size_t wordsPerEvent)
+{
+    // Blocks discarded while this lane's ring was full (or the DMA IRQ was
+    // late) only count once the ones before them have been read: a lane
+    // gets to them right when starting on the next block that made it
+    const uint32_t lost = m_blockRing[lane].TakeLost() / wordsPerEvent;
+    if (lost == 0) {
+        return;
+    }
+
+    m_losses.captureBuffer.fetch_add(lost, std::memory_order_relaxed);
+    if (m_pioMap.lanes > 1) {
+        // Keeps the lanes taking turns in the right order, the clock skips
+        // them as their turns come up
+        m_laneSkip[lane] += lost;
+    } else if (wordsPerEvent > 1) {
+        // Their timestamps never made it to the clock
+        m_clock.Skip(lost);
+    }
+    MarkGap(LS_CaptureBuffer, lost);
+}
+
+void Logic::StartDmaCapture()
+{
+    for (uint lane = 0; lane < m_pioMap.lanes; lane++) {
+        auto& dma = m_dma[lane];
+        auto& handoff = m_handoff[lane];
+        const uint sm = m_pioMap.LaneSm(lane);
+        m_blockRing[lane].Reset();
+        handoff.Reset(&m_blockRing[lane], m_dmaDiscard.data());
+
+        dma.data = dma_claim_unused_channel(true);
+        dma.control = dma_claim_unused_channel(true);
+        dma.retire = dma_claim_unused_channel(true);
+
+        // The data channel moves one block worth of words from the RX FIFO, then
+        // chains to the control channel, which loads the next block address from
+        // the handoff table and triggers it again. The retire channel then marks
+        // that entry used. The completion IRQ only keeps the table filled in, see
+        // DmaHandoff. Each lane gets its own set.
+        dma_channel_config dataCfg = dma_channel_get_default_config(dma.data);
+        channel_config_set_transfer_data_size(&dataCfg, DMA_SIZE_32);
+        channel_config_set_read_increment(&dataCfg, false);
+        channel_config_set_write_increment(&dataCfg, true);
+        channel_config_set_dreq(&dataCfg, pio_get_dreq(m_pioMap.hwBase, sm, false));
+        channel_config_set_chain_to(&dataCfg, dma.control);
+        channel_config_set_high_priority(&dataCfg, true);
+        dma_channel_configure(dma.data, &dataCfg, nullptr,
+            &m_pioMap.hwBase->rxf[sm], CAPTURE_BLOCK_WORDS, false);
+
+        dma_channel_config controlCfg = dma_channel_get_default_config(dma.control);
+        channel_config_set_transfer_data_size(&controlCfg, DMA_SIZE_32);
+        channel_config_set_read_increment(&controlCfg, true);
+        channel_config_set_write_increment(&controlCfg, false);
+        channel_config_set_ring(&controlCfg, false, std::countr_zero(handoff.c_tableBytes));
+        channel_config_set_chain_to(&controlCfg, dma.retire);
+        channel_config_set_high_priority(&controlCfg, true);
+        dma_channel_configure(dma.control, &controlCfg, &dma_hw->ch[dma.data].al2_write_addr_trig,
+            handoff.Table(), 1, false);
+        dma_channel_set_irq1_enabled(dma.control, true);
+
+        dma_channel_config retireCfg = dma_channel_get_default_config(dma.retire);
+        channel_config_set_transfer_data_size(&retireCfg, DMA_SIZE_32);
+        channel_config_set_read_increment(&retireCfg, false);
+        channel_config_set_write_increment(&retireCfg, true);
+        channel_config_set_ring(&retireCfg, true, std::countr_zero(handoff.c_tableBytes));
+        channel_config_set_high_priority(&retireCfg, true);
+        dma_channel_configure(dma.retire, &retireCfg, handoff.Table(), handoff.DiscardEntry(), 1, false);
+    }
+
+    irq_set_enabled(CAPTURE_DMA_IRQ, false);
+    irq_set_priority(CAPTURE_DMA_IRQ, PICO_HIGHEST_IRQ_PRIORITY + 5);
+    irq_set_exclusive_handler(CAPTURE_DMA_IRQ, &Logic::BusDmaISR);
+    irq_set_enabled(CAPTURE_DMA_IRQ, true);
+
+    for (uint lane = 0; lane < m_pioMap.lanes; lane++) {
+        dma_channel_start(m_dma[lane].control);
+    }
+}
+
+void Logic::StopDmaCapture()
+{
+    irq_set_enabled(CAPTURE_DMA_IRQ, false);
+
+    for (uint lane = 0; lane < m_pioMap.lanes; lane++) {
+        auto& dma = m_dma[lane];
+        dma_channel_set_irq1_enabled(dma.control, false);
+
+        // Aborting a chained channel may trigger the one it chains to (RP2040-E13),
+        // so point each channel to itself before pulling the plug. The control
+        // channel goes first, or it could trigger the data channel again.
+        for (const uint channel : { dma.data, dma.control }) {
+            dma_channel_config dmaCfg = dma_get_channel_config(channel);
+            channel_config_set_chain_to(&dmaCfg, channel);
+            dma_channel_set_config(channel, &dmaCfg, false);
+        }
+
+        for (int* channel : { &dma.control, &dma.retire, &dma.data }) {
+            dma_channel_abort(*channel);
+            dma_channel_acknowledge_irq1(*channel);
+            dma_channel_unclaim(*channel);
+            *channel = -1;
+        }
+    }
+
+    irq_remove_handler(CAPTURE_DMA_IRQ, &Logic::BusDmaISR);
+}
+
+std::span<const Logic::AddressDecoding::SourceType> Logic::PeekDmaCapture(uint lane)
+{
+    // The completion IRQ runs on this same core, keep it from moving the
+    // goalposts while figuring out how far the in-flight block got
+    const uint32_t irqState = save_and_disable_interrupts();
+    const size_t landed = m_handoff[lane].Landed(dma_channel_hw_addr(m_dma[lane].data)->write_addr);
+    const auto block = m_blockRing[lane].Peek(landed);
+    restore_interrupts(irqState);
+
+    return block;
+}
+
 Logic* Logic::s_instance { nullptr };
 
-void Logic::BusReaderISR(void)
+template <Logic::PortMatch Match, Logic::LedBlink Blink, Logic::CaptureEngine Engine>
+__force_inline bool Logic::DrainCaptureFifo()
 {
-    const auto& pioMap = s_instance->m_pioMap;
-    AddressDecoding::TargetType temp {};
-    while (!(pioMap.hwBase->fstat & (1u << (PIO_FSTAT_RXEMPTY_LSB + pioMap.readerSm)))) {
-        temp = AddressDecoding::ParseBusRead(pioMap.hwBase->rxf[pioMap.readerSm]);
-        if (pioMap.filterAddress == temp.Address()) {
+    // Bus_FilteredRead pushes nothing but data, all others a timestamp after each sample
+    constexpr bool pioStamp = (Match != PortMatch::Pio);
+
+    // Calls below may touch any member, so whatever is fixed for the whole
+    // reader is copied here once, instead of being reloaded after each one
+    const PIO pio = m_pioMap.hwBase;
+    const uint16_t filterAddress = m_pioMap.filterAddress;
+    const uint laneSm[c_maxLanes] { m_pioMap.LaneSm(0), m_pioMap.LaneSm(m_pioMap.lanes - 1) };
+    bool queued = false;
+
+    const uint64_t settled = CaptureClock::FromMicros(time_us_64() - RESET_SETTLE_US);
+    CheckCaptureLosses();
+    // With Bus_PingPong, lanes are read in turn, which is the order cycles came in
+    uint sm = laneSm[m_turn];
+    while (!(pio->fstat & (1u << (PIO_FSTAT_RXEMPTY_LSB + sm)))) {
+        const auto busData = pioStamp
+            ? AddressDecoding::ParseBusRead(pio->rxf[sm])
+            : AddressDecoding::ParseFilteredRead(pio->rxf[sm], filterAddress);
+
+        uint64_t when;
+        if constexpr (pioStamp) {
+            // Timestamp is pushed a PIO cycle or two after its sample
+            while (pio->fstat & (1u << (PIO_FSTAT_RXEMPTY_LSB + sm))) {
+                tight_loop_contents();
+            }
+            // Every stamp goes through the clock, even for cycles filtered out below
+            when = ResolveStamp(pio->rxf[sm], time_us_64());
+            sm = laneSm[m_turn];
+        } else {
+            // Hardly ever fires, so stamping on arrival is close enough
+            when = CaptureClock::FromMicros(time_us_64());
+        }
+
+        if constexpr (Match == PortMatch::Bitmap) {
+            if (!m_filter.Test(busData.Address())) {
+                continue;
+            }
+        }
+
+        if constexpr (Engine == CaptureEngine::Polled) {
+            // Same as the DMA loop, see there
+            while (m_policy.load(std::memory_order_relaxed) == OverflowPolicy::Lossless
+                && m_triggerState.load(std::memory_order_relaxed) == TriggerState::Off
+                && m_events->Free() < 4 && !GetQuitFlag()) {
+                tight_loop_contents();
+            }
+        }
+
+        DrainResets(when);
+        EmitEvent(when, {
+            .address = busData.Address(),
+            .data = busData.data,
+            .operation = QueueOperation::P80Data,
+        });
+        if constexpr (Blink == LedBlink::PerEvent) {
             gpio_xor_mask(1 << PICO_DEFAULT_LED_PIN);
-            s_instance->m_ringBuffer.push({
-                .type = TimelineEntry::Type::Data,
-                .busData = temp,
-            });
+        }
+        queued = true;
+    }
+
+    if constexpr (Blink == LedBlink::RateLimited) {
+        if (queued) {
+            BlinkActivity(time_us_64());
         }
     }
-    irq_clear(pioMap.pioIrq);
+    // Whatever happened on the bus before this point has been queued
+    DrainResets(settled);
+    FlushQuietRepeats(settled);
+    return queued;
 }
 
-void Logic::BusReaderNoFilterISR(void)
+template <Logic::PortMatch Match, Logic::LedBlink Blink>
+void __not_in_flash_func(Logic::CaptureISR)(void)
 {
-    const auto& pioMap = s_instance->m_pioMap;
-    AddressDecoding::TargetType temp {};
-    while (!(pioMap.hwBase->fstat & (1u << (PIO_FSTAT_RXEMPTY_LSB + pioMap.readerSm)))) {
-        temp = AddressDecoding::ParseBusRead(pioMap.hwBase->rxf[pioMap.readerSm]);
-        s_instance->m_ringBuffer.push({
-            .type = TimelineEntry::Type::Data,
-            .busData = temp,
-        });
+    s_instance->DrainCaptureFifo<Match, Blink, CaptureEngine::Interrupt>();
+    irq_clear(s_instance->m_pioMap.pioIrq);
+}
+
+template <Logic::PortMatch Match, Logic::LedBlink Blink>
+void __not_in_flash_func(Logic::PollCapture)(void)
+{
+    // Each word gets handled right as it lands, there's nothing else to do here
+    Logic* const self = s_instance;
+    while (!self->GetQuitFlag()) {
+        self->DrainCaptureFifo<Match, Blink, CaptureEngine::Polled>();
+    }
+}
+
+Logic::CaptureHandler Logic::SelectCaptureHandler(CaptureEngine engine, PortMatch match, LedBlink blink)
+{
+    // Indexed by PortMatch, then LedBlink
+    static constexpr CaptureHandler isrs[3][2] {
+        { &CaptureISR<PortMatch::Pio, LedBlink::PerEvent>, &CaptureISR<PortMatch::Pio, LedBlink::RateLimited> },
+        { &CaptureISR<PortMatch::Any, LedBlink::PerEvent>, &CaptureISR<PortMatch::Any, LedBlink::RateLimited> },
+        { &CaptureISR<PortMatch::Bitmap, LedBlink::PerEvent>, &CaptureISR<PortMatch::Bitmap, LedBlink::RateLimited> },
+    };
+    static constexpr CaptureHandler loops[3][2] {
+        { &PollCapture<PortMatch::Pio, LedBlink::PerEvent>, &PollCapture<PortMatch::Pio, LedBlink::RateLimited> },
+        { &PollCapture<PortMatch::Any, LedBlink::PerEvent>, &PollCapture<PortMatch::Any, LedBlink::RateLimited> },
+        { &PollCapture<PortMatch::Bitmap, LedBlink::PerEvent>, &PollCapture<PortMatch::Bitmap, LedBlink::RateLimited> },
+    };
+
+    if (engine == CaptureEngine::Dma) {
+        // DMA loop has its own way
+        return nullptr;
+    }
+    const auto& table = (engine == CaptureEngine::Polled) ? loops : isrs;
+    return table[static_cast<size_t>(match)][static_cast<size_t>(blink)];
+}
+
+void __not_in_flash_func(Logic::BlinkActivity)(uint64_t nowUs)
+{
+    if (nowUs - m_ledToggleAt >= LED_BLINK_US) {
         gpio_xor_mask(1 << PICO_DEFAULT_LED_PIN);
+        m_ledToggleAt = nowUs;
     }
-    irq_clear(pioMap.pioIrq);
 }
 
-void Logic::ResetPulseISR(uint gpio, uint32_t event_mask)
+void __not_in_flash_func(Logic::BusDmaISR)(void)
 {
-    if (gpio != s_instance->m_resetPin)
-        return;
+    for (uint lane = 0; lane < s_instance->m_pioMap.lanes; lane++) {
+        const auto& dma = s_instance->m_dma[lane];
+        auto& handoff = s_instance->m_handoff[lane];
+        if (!dma_channel_get_irq1_status(dma.control)) {
+            continue;
+        }
 
-    if (event_mask & GPIO_IRQ_EDGE_RISE) {
-        s_instance->m_ringBuffer.push({
-            .type = TimelineEntry::Type::Reset,
-            .resetEvent = QueueOperation::P80ResetActive,
-        });
-    } else if (event_mask & GPIO_IRQ_EDGE_FALL) {
-        s_instance->m_ringBuffer.push({
-            .type = TimelineEntry::Type::Reset,
-            .resetEvent = QueueOperation::P80ResetCleared,
-        });
+        // Acknowledge first: an entry loaded after this raises the IRQ again.
+        // However late this runs, the control channel's read address tells
+        // how many blocks went by.
+        dma_channel_acknowledge_irq1(dma.control);
+        const uintptr_t readAddr = dma_channel_hw_addr(dma.control)->read_addr;
+        handoff.Advance((readAddr - reinterpret_cast<uintptr_t>(handoff.Table())) / sizeof(uintptr_t));
     }
 }
 
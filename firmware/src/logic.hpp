@@ -7,7 +7,18 @@
 #ifndef PICOPOST_LOGIC_HPP
 #define PICOPOST_LOGIC_HPP
 
+#include "blockring.hpp"
+#include "bustiming.hpp"
+#include "captureclock.hpp"
 #include "common.hpp"
+#include "cyclestats.hpp"
+#include "dmahandoff.hpp"
+#include "flashlog.hpp"
+#include "heatmap.hpp"
+#include "picoflash.hpp"
+#include "portfilter.hpp"
+#include "spscring.hpp"
+#include "trigger.hpp"
 #include "voltmon.hpp"
 
 #include "cfg/pins.h"
@@ -17,12 +28,47 @@
 #include <array>
 #include <atomic>
 #include <memory>
-#include <optional>
+#include <span>
 
 class Logic {
 public:
     static constexpr uint16_t AllAddresses { 0x0000 };
 
+    using EventRing = SpscRing<BusEvent, QUEUE_DEPTH>;
+    using DeepLog = FlashLog<PicoFlash>;
+
+    /**
+     * @brief Where the capture stands with respect to the trigger, if any.
+     *
+     */
+    enum class TriggerState : uint8_t {
+        Off, ///< No trigger set, events flow as usual
+        Armed, ///< Waiting for the trigger, UI only keeps the pre-trigger window
+        Triggered, ///< Collecting post-trigger events
+        Frozen, ///< Post-trigger window is full, no more events until the reader restarts
+    };
+
+    /**
+     * @brief Events lost along the capture path since the reader started.
+     *
+     */
+    struct CaptureLosses {
+        uint32_t pioStalls { 0 }; ///< Times the PIO RX FIFO filled up. Cycles missed meanwhile can't be counted.
+        uint32_t captureBuffer { 0 }; ///< Events thrown away along with discarded DMA blocks
+        uint32_t eventRing { 0 }; ///< Events dropped because the ring to the UI was full
+    };
+
+    /**
+     * @brief How captured bus words travel from the PIO RX FIFO to the
+     * capture loop.
+     *
+     */
+    enum class CaptureEngine : uint8_t {
+        Interrupt, ///< PIO IRQ fires on RX FIFO not empty, words are pulled one by one
+        Dma, ///< A DMA channel drains the RX FIFO into a block ring, a second one re-arms it
+        Polled, ///< Capture core spins on the RX FIFO status, no interrupts at all
+    };
+
     Logic();
 
     /**
@@ -33,7 +79,7 @@ public:
     void Stop();
 
     /**
-     * @brief Reads I/O port and pushes data to the reader queue.
+     * @brief Reads I/O port and pushes data to the event ring.
      *
      * @par
      * This is the primary target for this project.
@@ -41,25 +87,261 @@ public:
      * to listen for the Bus_Ready signal to come up, then it samples the address
      * and data busses in one shot. The read operation itself is so fast, the ISA
      * bus itself could be read 4 times in a single host transaction!
-     * Data is then sent to the queue, so the second core can waste time for
-     * graphical and serial output.
+     * Events are then pushed to the ring, so the other core can waste time for
+     * graphical and serial output, reading them in place.
+     *
+     * @par
+     * When listening to a single port, the comparison against baseAddress is
+     * done by the PIO itself (Bus_FilteredRead), so only matching cycles ever
+     * reach the RX FIFO. Bus dump uses Bus_FastRead, which pushes everything.
+     * Filters matching more than one port also use Bus_FastRead, and each cycle
+     * is then checked against the PortFilter bitmap before being queued.
+     *
+     * @par
+     * With CaptureEngine::Dma, the RX FIFO is drained by a DMA channel instead,
+     * filling one block of the capture ring after the other, as loaded by a
+     * control channel from the addresses the completion IRQ keeps armed.
+     * The capture loop is then only woken up when a block completes, or when
+     * the bus has been quiet for a while and a partial block is pending.
+     *
+     * @par
+     * With CaptureEngine::Polled, the capture core does nothing but poll the
+     * RX FIFO status, from SRAM, and handles each word as soon as it lands:
+     * no NVIC entry and exit, no flash fetches, no block bookkeeping. It's the
+     * fastest way through for bus dump, as long as the UI keeps up, since
+     * there's nothing but the RX FIFO to absorb bursts.
      *
+     * @par
+     * With SetPingPong(), Bus_FastRead is replaced by Bus_PingPong on two SMs
+     * taking turns. Each one has its own RX FIFO (and DMA block ring), and the
+     * capture loop takes events from them in turn, which is their bus order.
+     *
+     * @par
+     * Reset is watched by a second SM (Reset_Watch), whose timestamps run in
+     * lockstep with Bus_FastRead. Edges are debounced on the pulse width
+     * measured by the PIO, then merged into the event stream by capture time,
+     * so reset markers never overtake the last POST codes before them.
+     * P80ResetCleared carries the measured width.
+     *
+     * @par
+     * Events are timestamped when they happen, not when they get dequeued.
+     * Bus_FastRead pushes its own tick counter after each sample, which is
+     * turned back into absolute time by CaptureClock. Bus_FilteredRead has no
+     * register left for that, but it hardly ever fires, so its ISR stamps
+     * each event as soon as it shows up in the FIFO.
+     *
+     * @param list Ring of BusEvent, for the UI to consume
      * @param baseAddress Address to listen to. Default 80h, some systems output on
      * different ports.
+     * @param engine How the RX FIFO gets drained
+     *
+     */
+    void AddressReader(EventRing* list, bool newPcb, const uint16_t baseAddress = 0x0080,
+        const CaptureEngine engine = CaptureEngine::Interrupt);
+
+    /**
+     * @brief Same as above, but listens to every port matched by filter.
+     *
+     * @param filter Ports to listen to. It gets copied, so it can be changed
+     * while the reader is running.
+     */
+    void AddressReader(EventRing* list, bool newPcb, const PortFilter& filter,
+        const CaptureEngine engine = CaptureEngine::Interrupt);
+
+    /**
+     * @brief Same as above, for a short list of ports. No 8 KB bitmap needed
+     * on the caller's side, the list is built into the reader's own filter.
+     *
+     * @param ports Ports to listen to
+     */
+    void AddressReader(EventRing* list, bool newPcb, std::span<const uint16_t> ports,
+        const CaptureEngine engine = CaptureEngine::Interrupt);
+
+    /**
+     * @brief Listens to port 80h like AddressReader(), and records every
+     * queued event to flash too, one session per boot of the host.
+     *
+     * @par
+     * Capture is interrupt driven, like the other port 80h readers, so each
+     * POST code gets the time it came in, and the ISR is the only one feeding
+     * the DeepLog. Full blocks get programmed from the capture loop, sectors
+     * get erased once the bus has been quiet for a while, with interrupts
+     * held off meanwhile: the PIO FIFO holds what it can, anything past that
+     * shows up as a gap. Events the UI never got, because the ring was full,
+     * are left out of the log as well, and show up as the same gap markers.
+     *
+     * @par
+     * If the flash region can't be used, it's just a port 80h reader.
+     *
+     * @param list Ring of BusEvent, for the UI to consume
+     */
+    void DeepCapture(EventRing* list, bool newPcb);
+
+    /**
+     * @brief Returns the log DeepCapture() records into. Only use it while
+     * no reader is running.
+     *
+     */
+    DeepLog& GetDeepLog();
+
+    /**
+     * @brief Picks what happens when the UI falls behind. Can be changed at
+     * any time, and it's kept across readers.
+     *
+     * @par
+     * ISRs can't wait for anyone, so with CaptureEngine::Interrupt a full ring
+     * always drops the newest events. CaptureEngine::Polled does wait, and the
+     * PIO stalls meanwhile. Whatever gets lost, and wherever it gets
+     * lost, a P80Gap marker is queued right before the next event that makes it.
+     */
+    void SetOverflowPolicy(OverflowPolicy policy);
+
+    /**
+     * @brief Has readers listening to more than a single port sample the bus
+     * with two SMs taking turns, instead of one. Kept across readers, applies
+     * from the next one.
+     *
+     * @par
+     * One SM being stuck on a full RX FIFO no longer keeps the other one from
+     * catching the next cycle, and bursts get twice the FIFO depth.
+     */
+    void SetPingPong(bool enabled);
+
+    /**
+     * @brief Folds runs of identical writes (same port, same data) into a
+     * single P80Data event, followed by a P80Repeat one when the run ends.
+     * Kept across readers, applies right away.
+     *
+     * @par
+     * Delay loops on port 80h or EDh, and PIC/PIT programming done over and
+     * over, then take two ring slots per run instead of one per write. Runs
+     * end on anything else being queued, on lost events, and after the bus
+     * stays quiet for a bit, so the count never lags too far behind.
+     */
+    void SetCoalescing(bool enabled);
+
+    /**
+     * @brief Sets the trigger used by the next address reader. Only call while
+     * no reader is running.
+     *
+     * @par
+     * Every event queued by the reader is fed to the trigger. Once it fires,
+     * a P80Trigger marker is queued, postEvents more events go through, then
+     * the stream freezes. Keeping the pre-trigger window is up to the UI, which
+     * simply throws away whatever is older while the trigger is armed.
+     *
+     * @param trigger Conditions to match, an empty one disables triggering
+     * @param postEvents How many events to keep after the trigger fires
+     */
+    void SetTrigger(const TriggerEngine& trigger, uint32_t postEvents);
+
+    TriggerState GetTriggerState() const;
+
+    /**
+     * @brief Returns loss counters for the current (or last) address reader.
+     *
+     */
+    CaptureLosses GetLosses() const;
+
+    /**
+     * @brief Looks for the fastest PIO timings this bus can be read with.
+     *
+     * @par
+     * Every mux delay and clock divider pair is tried in turn, for a short
+     * while each, on whatever the host is doing meanwhile (POST is ideal).
+     * A sample is torn when its two data bytes, taken before and after the
+     * bank switch, don't match, or when its address was never seen while
+     * running with the default, conservative timings. Ports are checked that
+     * way because a mux that didn't settle only garbles the address.
+     *
+     * @par
+     * The pair with the shortest dead time and no torn samples at all is kept
+     * for all readers started afterwards. Each step is reported with a
+     * CalibrationStep event, the outcome with a CalibrationDone event.
+     *
+     * @param list Ring of BusEvent, for the UI to consume
+     */
+    void CalibrateTiming(EventRing* list);
+
+    /**
+     * @brief Times every IO write on the bus, and keeps per-port histograms
+     * of how long each one took and how long the bus was quiet before it.
+     *
+     * @par
+     * Bus_TimingRead stamps each cycle twice, as it gets sampled and as
+     * bus_ready goes low again. Widths and gaps come out of the difference,
+     * in PIO cycles, and only end up in CycleStats counters: nothing is
+     * queued for the UI, which fetches a summary with GetCycleStats().
+     *
+     */
+    void CycleTiming();
+
+    /**
+     * @brief Copies the histograms built by CycleTiming(), running or not.
+     * Counters may be updated while being copied, so totals can be a couple
+     * of cycles apart.
+     *
+     */
+    void GetCycleStats(CycleStats& stats) const;
+
+    /**
+     * @brief Counts IO writes per port, for as long as it runs, to find out
+     * which devices the BIOS talks to and how much.
+     *
+     * @par
+     * Same polled loop as CycleTiming(), with plain timestamps. Each write is
+     * a single counter bump in PortHeatmap, nothing gets queued: the UI
+     * fetches the counters with GetHeatmap() whenever it wants to refresh.
      *
      */
-    void AddressReader(queue_t* list, bool newPcb, const uint16_t baseAddress = 0x0080);
+    void PortInventory();
+
+    /**
+     * @brief Copies the counters built by PortInventory(), running or not.
+     * Same caveat as GetCycleStats(), totals may be slightly off.
+     *
+     */
+    void GetHeatmap(PortHeatmap& heatmap) const;
+
+    /**
+     * @brief Returns the timings used by address readers.
+     *
+     */
+    BusTiming GetBusTiming() const;
 
     /**
      * @brief Uses the ADC to probe the 5V and 12V supply rails
      *
      * @par
      * Simply reads 5V and 12V monitoring pins for the ADC about every 100 ms, then
-     * sends data to the queue for the serial port (or OLED) to display.
+     * sends a VoltageSample to the queue for the serial port (or OLED) to display.
      *
      */
     void VoltageMonitor(queue_t* list);
 
+    /**
+     * @brief Measures the ISA bus clock, BCLK, and how much it wanders.
+     *
+     * @par
+     * Two SMs run Bus_ClockMeter on the BCLK pin, at full system clock. One
+     * of them times long windows of about a million periods, for frequency,
+     * the other one times single periods, which give the shortest and longest
+     * cycle seen meanwhile. The CPU only ever sees the results. A ClockSample
+     * is queued for each long window, or every now and then if BCLK stops.
+     *
+     * @par
+     * Only the rev 6 PCB routes BCLK to the Pico, older ones get no samples.
+     *
+     */
+    void ClockMeter(queue_t* list, bool newPcb);
+
+    /**
+     * @brief Returns the last BCLK frequency measured by ClockMeter(), in Hz,
+     * or zero if it never ran or found no clock.
+     *
+     */
+    uint32_t GetBusClock() const;
+
 private:
     enum class ResetStage : uint8_t {
         Inactive,
@@ -68,13 +350,88 @@ private:
         DebounceInactive
     };
 
+    static constexpr uint c_maxLanes { 2 };
+
+    enum class ReaderProgram : uint8_t {
+        FilteredRead, ///< Bus_FilteredRead, single port
+        FastRead, ///< Bus_FastRead
+        PingPong, ///< Bus_PingPong, on two SMs
+        TimingRead, ///< Bus_TimingRead
+    };
+
+    using CaptureHandler = void (*)(void);
+
+    // CaptureISR policy: where non-matching ports get dropped
+    enum class PortMatch : uint8_t {
+        Pio, ///< Bus_FilteredRead, only the wanted port reaches the FIFO
+        Any, ///< Bus dump, everything goes
+        Bitmap, ///< Checked against m_filter
+    };
+
+    // CaptureISR policy: how the activity LED follows the events
+    enum class LedBlink : uint8_t {
+        PerEvent, ///< Toggled on every event, for the odd POST code
+        RateLimited, ///< Toggled at a human-visible pace, for busy readers
+    };
+
     struct PortReaderPIO {
         PIO hwBase;
+        const pio_program_t* program { nullptr };
         uint readerOffset { 0 };
         int readerSm { -1 };
+        int pairSm { -1 }; // Bus_PingPong only
+        uint lanes { 1 };
+        uint resetOffset { 0 };
+        int resetSm { -1 };
         uint pioIrq { 0 };
-        uint rstIrq { 0 };
         uint16_t filterAddress {};
+        bool useBitmap { false };
+
+        inline uint LaneSm(uint lane) const
+        {
+            return static_cast<uint>(lane == 0 ? readerSm : pairSm);
+        }
+
+        inline uint32_t LaneMask() const
+        {
+            return (1u << readerSm) | (lanes > 1 ? (1u << pairSm) : 0);
+        }
+    };
+
+    struct ResetTracker {
+        ResetStage stage { ResetStage::Inactive };
+        uint64_t riseAt { 0 }; // CaptureClock units
+        uint64_t fallAt { 0 };
+        uint64_t next { 0 }; // Edge pulled from the FIFO, not yet due
+        bool haveNext { false };
+    };
+
+    struct DmaCapture {
+        int data { -1 };
+        int control { -1 }; // Re-arms the data channel from the handoff table
+        int retire { -1 }; // Puts the discard entry back in the table once used
+    };
+
+    struct LossTracker {
+        std::atomic<uint32_t> pioStalls { 0 };
+        std::atomic<uint32_t> captureBuffer { 0 };
+        std::atomic<uint32_t> eventRing { 0 };
+        uint32_t pendingLost { 0 }; // Not yet reported with a gap marker
+        uint8_t pendingStages { LS_None };
+    };
+
+    struct RepeatRun {
+        bool open { false }; // Last queued event was P80Data, and matching ones can be folded
+        uint16_t address { 0 };
+        uint8_t data { 0 };
+        uint32_t count { 0 }; // Folded since the last P80Repeat
+        uint64_t lastAt { 0 }; // CaptureClock units
+    };
+
+    struct TimingProbe {
+        uint32_t samples { 0 };
+        uint32_t tornData { 0 }; // Data bytes didn't match
+        uint32_t strayAddress { 0 }; // Address not seen with default timings
     };
 
     struct AddressDecoding {
@@ -95,90 +452,111 @@ private:
         {
             return std::bit_cast<TargetType>(raw);
         }
-    };
-
-    struct TimelineEntry {
-        enum class Type : uint8_t {
-            Data,
-            Reset,
-        };
-
-        Type type { Type::Data };
-        union {
-            AddressDecoding::TargetType busData {};
-            QueueOperation resetEvent;
-        };
-    };
 
-    template <typename T, size_t Size>
-    class RingBuffer {
-        static_assert((Size & (Size - 1)) == 0, "Size must be a power of 2");
-
-    public:
-        // Insert an element. Returns false and drops the insertion if buffer is full.
-        bool push(const T& item)
+        // Bus_FilteredRead only carries data, on the top byte. Address is implied.
+        static inline TargetType ParseFilteredRead(SourceType raw, uint16_t address)
         {
-            const size_t currWriteHead = writeHead.load(std::memory_order_relaxed);
-            const size_t currReadHead = readHead.load(std::memory_order_acquire);
-
-            if (full.load(std::memory_order_acquire)) {
-                return false;
-            }
-
-            buffer[currWriteHead] = item;
-            const size_t nextHead = increment(currWriteHead);
-            writeHead.store(nextHead, std::memory_order_release);
-
-            if (nextHead == currReadHead) {
-                full.store(true, std::memory_order_release);
-            }
-
-            return true;
+            const uint8_t data = static_cast<uint8_t>(raw >> 24);
+            return {
+                .dataCopy = data,
+                .addrLo = static_cast<uint8_t>(address & 0xFF),
+                .data = data,
+                .addrHi = static_cast<uint8_t>(address >> 8),
+            };
         }
-
-        // Extract an element. Returns std::nullopt if buffer is empty.
-        std::optional<T> pop()
-        {
-            const size_t currReadHead = readHead.load(std::memory_order_relaxed);
-            const size_t currWriteHead = writeHead.load(std::memory_order_acquire);
-
-            if (!full.load(std::memory_order_acquire) && currReadHead == currWriteHead) {
-                return std::nullopt;
-            }
-
-            T item = buffer[currReadHead];
-            const size_t nextTail = increment(currReadHead);
-            readHead.store(nextTail, std::memory_order_release);
-            full.store(false, std::memory_order_release);
-
-            return item;
-        }
-
-    private:
-        constexpr size_t increment(size_t index) const
-        {
-            return (index + 1) & (Size - 1); // Wrap-around
-        }
-
-        std::array<T, Size> buffer {};
-        std::atomic<size_t> writeHead { 0 }; // Producer (ISR)
-        std::atomic<size_t> readHead { 0 }; // Consumer (main)
-        std::atomic<bool> full { false };
     };
 
     static Logic* s_instance;
 
     uint64_t m_lastReset { 0 };
+    uint64_t m_lastEvent { 0 }; // CaptureClock units
     uint m_resetPin { PIN_ISA_RST_R6 };
     volatile bool m_appRunning { false };
     std::atomic<bool> m_quitLoop { false };
     PortReaderPIO m_pioMap {};
+    pio_program_t m_program {}; // Reader program as loaded, with mux delays patched in
+    std::array<uint16_t, PIO_INSTRUCTION_COUNT> m_programCode {};
+    std::atomic<BusTiming> m_timing;
+    std::atomic<uint32_t> m_busClockHz { 0 };
+    CycleStats m_cycleStats {};
+    PortHeatmap m_heatmap {};
     std::unique_ptr<VoltMon> m_volts {};
-    RingBuffer<TimelineEntry, QUEUE_DEPTH> m_ringBuffer {};
+    EventRing* m_events { nullptr };
+    DmaCapture m_dma[c_maxLanes] {};
+    BlockRing<AddressDecoding::SourceType, CAPTURE_BLOCK_WORDS, CAPTURE_BLOCK_COUNT> m_blockRing[c_maxLanes] {};
+    DmaHandoff<AddressDecoding::SourceType, CAPTURE_BLOCK_WORDS, CAPTURE_BLOCK_COUNT> m_handoff[c_maxLanes] {};
+    std::array<AddressDecoding::SourceType, CAPTURE_BLOCK_WORDS> m_dmaDiscard {};
+    CaptureClock m_clock {};
+    uint32_t m_laneStamp[c_maxLanes] {}; // Last raw stamp of each lane
+    uint32_t m_laneSkip[c_maxLanes] {}; // Events a lane lost to DMA overruns, still to be stepped over
+    uint m_turn { 0 }; // Lane the next event comes from
+    std::atomic<bool> m_pingPong { false };
+    std::atomic<bool> m_coalesce { false };
+    RepeatRun m_repeats {};
+    CaptureClock m_resetClock {};
+    ResetTracker m_reset {};
+    PortFilter m_filter {};
+    LossTracker m_losses {};
+    std::atomic<OverflowPolicy> m_policy { OverflowPolicy::Lossless };
+    TriggerEngine m_trigger {};
+    std::atomic<TriggerState> m_triggerState { TriggerState::Off };
+    uint32_t m_postTrigger { 0 };
+    uint32_t m_postLeft { 0 };
+    CaptureHandler m_captureHandler { nullptr }; // Picked once per reader
+    uint64_t m_ledToggleAt { 0 };
+    DeepLog m_deepLog {};
+    DeepLog* m_recorder { nullptr }; // Set while DeepCapture() runs
+
+    void RunAddressReader(EventRing* list, bool newPcb, const CaptureEngine engine);
+    void StartBusReader(ReaderProgram reader, uint16_t baseAddress, const BusTiming& timing);
+    void StopBusReader();
+    TimingProbe ProbeTiming(const BusTiming& timing, PortFilter& seen, bool learn);
+    void StartResetWatch(const BusTiming& timing);
+    void StopResetWatch();
+    void DrainResets(uint64_t until);
+    void FeedResetEdge(uint64_t when);
+    void SettleReset(uint64_t until);
+    bool EmitEvent(uint64_t when, BusEvent event);
+    bool PushEvent(uint64_t when, BusEvent event);
+    void UpdateTrigger(uint64_t when, const BusEvent& event);
+    void FlushRepeats();
+    void FlushQuietRepeats(uint64_t until);
+    void MarkGap(LossStage stage, uint32_t events);
+    uint64_t ResolveStamp(uint32_t stamp, uint64_t nowUs);
+    void CheckCaptureLosses();
+    void CheckBlockLosses(uint lane, size_t wordsPerEvent);
+    void StartDmaCapture();
+    void StopDmaCapture();
+    std::span<const AddressDecoding::SourceType> PeekDmaCapture(uint lane);
+    void BlinkActivity(uint64_t nowUs);
+
+    /**
+     * @brief Handles whatever sits in the RX FIFO, one instantiation per
+     * policy combination.
+     *
+     * @par
+     * Everything a reader can't change while it runs is settled at compile
+     * time: how ports get matched, where timestamps come from (Bus_FilteredRead
+     * has none, so PortMatch::Pio stamps on arrival), how the LED blinks, and
+     * whether it may wait for the UI. It's always inlined into its callers,
+     * CaptureISR() and PollCapture(), which run from SRAM.
+     *
+     * @return true if any event was queued
+     */
+    template <PortMatch Match, LedBlink Blink, CaptureEngine Engine>
+    __force_inline bool DrainCaptureFifo();
+
+    // RX FIFO not empty handler, CaptureEngine::Interrupt
+    template <PortMatch Match, LedBlink Blink>
+    static void CaptureISR(void);
+
+    // Capture core loop until quit, CaptureEngine::Polled
+    template <PortMatch Match, LedBlink Blink>
+    static void PollCapture(void);
 
-    static void BusReaderISR(void);
-    static void BusReaderNoFilterISR(void);
-    static void ResetPulseISR(uint gpio, uint32_t event_mask);
+    // RunAddressReader() picks one handler per reader with this
+    static CaptureHandler SelectCaptureHandler(CaptureEngine engine, PortMatch match, LedBlink blink);
+    static void BusDmaISR(void);
 
     __force_inline bool GetQuitFlag() const;
     __force_inline void SetQuitFlag(bool _flag);
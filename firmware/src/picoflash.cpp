@@ -0,0 +1,57 @@
+#include "picoflash.hpp"
+
+#include "hardware/regs/addressmap.h"
+#include "pico/flash.h"
+#include "pico/platform.h"
+
+// End of the firmware image, from the linker script
+extern char __flash_binary_end;
+
+// Core 0 services the lockout from an interrupt, this is only a safety net
+static constexpr uint32_t FLASH_LOCKOUT_MS { 500 };
+
+struct FlashOperation {
+    uint32_t offset;
+    const uint8_t* page; // nullptr to erase a sector
+};
+
+static void FlashExecute(void* param)
+{
+    const auto* operation = static_cast<const FlashOperation*>(param);
+    if (operation->page == nullptr) {
+        flash_range_erase(operation->offset, FLASH_SECTOR_SIZE);
+    } else {
+        flash_range_program(operation->offset, operation->page, FLASH_PAGE_SIZE);
+    }
+}
+
+PicoFlash::PicoFlash()
+{
+    const uintptr_t imageEnd = reinterpret_cast<uintptr_t>(&__flash_binary_end) - XIP_BASE;
+    const uint32_t size = FLASHLOG_SIZE - (FLASHLOG_SIZE % FLASH_SECTOR_SIZE);
+    if (size <= PICO_FLASH_SIZE_BYTES && PICO_FLASH_SIZE_BYTES - size >= imageEnd) {
+        base = PICO_FLASH_SIZE_BYTES - size;
+        sectors = size / FLASH_SECTOR_SIZE;
+    }
+}
+
+const uint8_t* PicoFlash::Read(size_t offset) const
+{
+    return reinterpret_cast<const uint8_t*>(XIP_NOCACHE_NOALLOC_BASE + base + offset);
+}
+
+void PicoFlash::Erase(size_t sector)
+{
+    FlashOperation operation { .offset = static_cast<uint32_t>(base + sector * FLASH_SECTOR_SIZE), .page = nullptr };
+    if (flash_safe_execute(&FlashExecute, &operation, FLASH_LOCKOUT_MS) != PICO_OK) {
+        panic("Flash erase locked out");
+    }
+}
+
+void PicoFlash::Program(size_t offset, const uint8_t* page)
+{
+    FlashOperation operation { .offset = static_cast<uint32_t>(base + offset), .page = page };
+    if (flash_safe_execute(&FlashExecute, &operation, FLASH_LOCKOUT_MS) != PICO_OK) {
+        panic("Flash program locked out");
+    }
+}
@@ -0,0 +1,54 @@
+/**
+ * @file picoflash.hpp
+ * @brief Region at the end of the onboard QSPI flash, as used by FlashLog.
+ *
+ */
+
+#ifndef PICOPOST_PICOFLASH_HPP
+#define PICOPOST_PICOFLASH_HPP
+
+#include "hardware/flash.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief The last FLASHLOG_SIZE bytes of the flash chip the firmware runs
+ * from.
+ *
+ * @par
+ * XIP is off while the chip erases or programs, so nothing may run from flash
+ * meanwhile, on either core. Each operation goes through flash_safe_execute(),
+ * which parks the other core and masks interrupts on this one, so both cores
+ * have to call flash_safe_execute_core_init() first. Capture interrupts wait
+ * too, the PIO FIFO holds what it can. A sector erase takes tens of
+ * milliseconds, which is why FlashLog only erases ahead while the bus is
+ * quiet.
+ *
+ * @par
+ * Reads go through the uncached XIP alias, so walking the whole region doesn't
+ * evict the firmware from the XIP cache. The region stays unused if the
+ * firmware image runs into it.
+ */
+class PicoFlash {
+public:
+    static constexpr size_t c_pageSize { FLASH_PAGE_SIZE };
+    static constexpr size_t c_sectorSize { FLASH_SECTOR_SIZE };
+
+    PicoFlash();
+
+    size_t Sectors() const
+    {
+        return sectors;
+    }
+
+    const uint8_t* Read(size_t offset) const;
+    void Erase(size_t sector);
+    void Program(size_t offset, const uint8_t* page);
+
+private:
+    uint32_t base { 0 }; // From the start of flash
+    size_t sectors { 0 };
+};
+
+#endif // PICOPOST_PICOFLASH_HPP
@@ -0,0 +1,151 @@
+/**
+ * @file portfilter.hpp
+ * @brief Set of IO ports to listen to, one bit per port.
+ *
+ */
+
+#ifndef PICOPOST_PORTFILTER_HPP
+#define PICOPOST_PORTFILTER_HPP
+
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+/**
+ * @brief IO port filter, compiled into a 64K-bit bitmap.
+ *
+ * @par
+ * Whatever the filter looks like (single ports, ranges, or a mix of both),
+ * checking a bus cycle against it is a single bit test. The whole map takes
+ * 8 KB, so keep instances out of the stack.
+ *
+ * @par
+ * Filters can be built from a textual spec such as "80,84,3F8-3FF" (hex, no
+ * suffix), which is what the USB "filter" command expects. "all" matches
+ * every port.
+ */
+class PortFilter {
+public:
+    static constexpr size_t c_ports { 65536 };
+
+    void Clear()
+    {
+        bits.fill(0);
+    }
+
+    void Fill()
+    {
+        bits.fill(UINT32_MAX);
+    }
+
+    void Add(uint16_t port)
+    {
+        bits[port >> 5] |= (1u << (port & 31));
+    }
+
+    void AddRange(uint16_t first, uint16_t last)
+    {
+        for (uint32_t port = first; port <= last; port++) {
+            Add(static_cast<uint16_t>(port));
+        }
+    }
+
+    inline bool Test(uint16_t port) const
+    {
+        return bits[port >> 5] & (1u << (port & 31));
+    }
+
+    // Number of ports matched by this filter
+    size_t Count() const
+    {
+        size_t count = 0;
+        for (const auto word : bits) {
+            count += std::popcount(word);
+        }
+        return count;
+    }
+
+    // Returns the matched port if there's only one, std::nullopt otherwise
+    std::optional<uint16_t> Single() const
+    {
+        if (Count() != 1) {
+            return std::nullopt;
+        }
+        return Next(0);
+    }
+
+    // Lowest matched port starting from `from`, std::nullopt if there are none left
+    std::optional<uint16_t> Next(uint32_t from) const
+    {
+        for (uint32_t port = from; port < c_ports; port++) {
+            if (Test(static_cast<uint16_t>(port))) {
+                return static_cast<uint16_t>(port);
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Replaces the filter with the ports listed in spec.
+     *
+     * @param spec Comma separated list of hex ports or ranges, or "all"
+     * @return false if spec is malformed or empty, filter is left untouched
+     */
+    bool Parse(std::string_view spec)
+    {
+        if (spec == "all") {
+            Fill();
+            return true;
+        }
+
+        // Validate everything first, so a typo doesn't wipe the current filter
+        if (!ForEachRange(spec, [](uint16_t, uint16_t) {})) {
+            return false;
+        }
+
+        Clear();
+        ForEachRange(spec, [this](uint16_t first, uint16_t last) { AddRange(first, last); });
+        return true;
+    }
+
+private:
+    std::array<uint32_t, c_ports / 32> bits {};
+
+    static std::optional<uint16_t> ParsePort(std::string_view text)
+    {
+        uint16_t port = 0;
+        const auto result = std::from_chars(text.data(), text.data() + text.size(), port, 16);
+        if (text.empty() || result.ec != std::errc {} || result.ptr != text.data() + text.size()) {
+            return std::nullopt;
+        }
+        return port;
+    }
+
+    template <typename Callback>
+    static bool ForEachRange(std::string_view spec, Callback&& callback)
+    {
+        size_t ranges = 0;
+        while (!spec.empty()) {
+            const size_t comma = spec.find(',');
+            const std::string_view item = spec.substr(0, comma);
+            spec = (comma == std::string_view::npos) ? std::string_view {} : spec.substr(comma + 1);
+
+            const size_t dash = item.find('-');
+            const auto first = ParsePort(item.substr(0, dash));
+            const auto last = (dash == std::string_view::npos) ? first : ParsePort(item.substr(dash + 1));
+            if (!first || !last || *last < *first) {
+                return false;
+            }
+
+            callback(*first, *last);
+            ranges++;
+        }
+        return ranges > 0;
+    }
+};
+
+#endif // PICOPOST_PORTFILTER_HPP
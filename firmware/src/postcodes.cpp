@@ -0,0 +1,240 @@
+#include "postcodes.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <iterator>
+
+struct CdbSource {
+    BiosVendor vendor;
+    uint8_t code;
+    const char* text;
+};
+
+// Only ever looked at while compiling, none of it makes it to the binary
+static constexpr CdbSource CDB_SOURCES[] {
+#include "postcodes.inc"
+};
+static constexpr size_t CDB_ENTRIES { std::size(CDB_SOURCES) };
+static_assert(CDB_ENTRIES > 0, "POST code database is empty, check cdb/*.txt");
+
+// About 80% of the slots in use, and four keys per bucket on average
+static constexpr size_t CDB_SLOTS { CDB_ENTRIES + CDB_ENTRIES / 4 + 1 };
+static constexpr size_t CDB_BUCKETS { CDB_ENTRIES / 4 + 1 };
+
+static constexpr uint16_t CdbKey(BiosVendor vendor, uint8_t code)
+{
+    return static_cast<uint16_t>((static_cast<uint16_t>(vendor) << 8) | code);
+}
+
+// Murmur3 finalizer, each seed makes for a different hash function
+static constexpr uint32_t CdbMix(uint16_t key, uint32_t seed)
+{
+    uint32_t hash = key ^ (seed * 0x9E3779B9u);
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static constexpr size_t CdbLength(const char* text)
+{
+    size_t length = 0;
+    while (text[length] != '\0') {
+        length++;
+    }
+    return length;
+}
+
+// First entry with the same description, which is the one that goes in the pool
+static constexpr size_t CdbFirstWith(size_t entry)
+{
+    const std::string_view text { CDB_SOURCES[entry].text };
+    for (size_t idx = 0; idx < entry; idx++) {
+        if (text == CDB_SOURCES[idx].text) {
+            return idx;
+        }
+    }
+    return entry;
+}
+
+static constexpr size_t CdbPoolSize()
+{
+    size_t size = 0;
+    for (size_t entry = 0; entry < CDB_ENTRIES; entry++) {
+        if (CdbFirstWith(entry) == entry) {
+            size += CdbLength(CDB_SOURCES[entry].text) + 1;
+        }
+    }
+    return size;
+}
+static_assert(CdbPoolSize() <= UINT16_MAX, "POST code descriptions don't fit 16-bit offsets");
+
+static constexpr bool CdbHasDuplicates()
+{
+    for (size_t entry = 0; entry < CDB_ENTRIES; entry++) {
+        for (size_t idx = 0; idx < entry; idx++) {
+            if (CDB_SOURCES[idx].vendor == CDB_SOURCES[entry].vendor && CDB_SOURCES[idx].code == CDB_SOURCES[entry].code) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+static_assert(!CdbHasDuplicates(), "Same POST code listed twice for a vendor, check cdb/*.txt");
+
+struct CdbSlot {
+    uint16_t key { 0 }; // Zero is free, BiosVendor::None never gets stored
+    uint16_t text { 0 }; // Offset in the pool
+};
+
+struct CdbTable {
+    std::array<char, CdbPoolSize()> pool {};
+    std::array<uint16_t, CDB_BUCKETS> seeds {};
+    std::array<CdbSlot, CDB_SLOTS> slots {};
+    std::array<uint16_t, static_cast<size_t>(BiosVendor::Compaq) + 1> counts {};
+    bool complete { false }; // Every bucket found a seed
+};
+
+/**
+ * @brief Builds the string pool and the perfect hash, CHD style: keys are
+ * split in buckets by a first hash, then each bucket, biggest first, looks for
+ * the seed of a second hash that sends all of its keys to free slots.
+ */
+static constexpr CdbTable CdbBuild()
+{
+    CdbTable table {};
+
+    std::array<uint16_t, CDB_ENTRIES> offsets {};
+    size_t used = 0;
+    for (size_t entry = 0; entry < CDB_ENTRIES; entry++) {
+        const size_t first = CdbFirstWith(entry);
+        if (first != entry) {
+            offsets[entry] = offsets[first];
+            continue;
+        }
+        offsets[entry] = static_cast<uint16_t>(used);
+        const char* text = CDB_SOURCES[entry].text;
+        do {
+            table.pool[used++] = *text;
+        } while (*text++ != '\0');
+    }
+
+    std::array<uint16_t, CDB_ENTRIES> bucketOf {};
+    std::array<size_t, CDB_BUCKETS> sizes {};
+    for (size_t entry = 0; entry < CDB_ENTRIES; entry++) {
+        const auto& source = CDB_SOURCES[entry];
+        bucketOf[entry] = static_cast<uint16_t>(CdbMix(CdbKey(source.vendor, source.code), 0) % CDB_BUCKETS);
+        sizes[bucketOf[entry]]++;
+        table.counts[static_cast<size_t>(source.vendor)]++;
+    }
+
+    std::array<size_t, CDB_BUCKETS> order {};
+    for (size_t bucket = 0; bucket < CDB_BUCKETS; bucket++) {
+        order[bucket] = bucket;
+    }
+    std::sort(order.begin(), order.end(), [&sizes](size_t lhs, size_t rhs) { return sizes[lhs] > sizes[rhs]; });
+
+    std::array<size_t, CDB_ENTRIES> taken {};
+    for (const size_t bucket : order) {
+        if (sizes[bucket] == 0) {
+            break;
+        }
+        bool placed = false;
+        for (uint32_t seed = 1; seed <= UINT16_MAX && !placed; seed++) {
+            size_t count = 0;
+            placed = true;
+            for (size_t entry = 0; entry < CDB_ENTRIES && placed; entry++) {
+                if (bucketOf[entry] != bucket) {
+                    continue;
+                }
+                const uint16_t key = CdbKey(CDB_SOURCES[entry].vendor, CDB_SOURCES[entry].code);
+                const size_t slot = CdbMix(key, seed) % CDB_SLOTS;
+                if (table.slots[slot].key != 0) {
+                    placed = false;
+                } else {
+                    table.slots[slot] = { .key = key, .text = offsets[entry] };
+                    taken[count++] = slot;
+                }
+            }
+            if (placed) {
+                table.seeds[bucket] = static_cast<uint16_t>(seed);
+            } else {
+                // Another key of this bucket was already there, try the next seed from scratch
+                while (count > 0) {
+                    table.slots[taken[--count]] = {};
+                }
+            }
+        }
+        if (!placed) {
+            return table;
+        }
+    }
+    table.complete = true;
+    return table;
+}
+
+static constexpr CdbTable CDB_TABLE { CdbBuild() };
+static_assert(CDB_TABLE.complete, "No perfect hash for the POST code database, try other table sizes");
+
+const char* PostCodeDatabase::Describe(BiosVendor vendor, uint8_t code)
+{
+    if (vendor == BiosVendor::None) {
+        return nullptr;
+    }
+    const uint16_t key = CdbKey(vendor, code);
+    const uint32_t seed = CDB_TABLE.seeds[CdbMix(key, 0) % CDB_BUCKETS];
+    const CdbSlot& slot = CDB_TABLE.slots[CdbMix(key, seed) % CDB_SLOTS];
+    return (slot.key == key) ? &CDB_TABLE.pool[slot.text] : nullptr;
+}
+
+size_t PostCodeDatabase::Count()
+{
+    return CDB_ENTRIES;
+}
+
+size_t PostCodeDatabase::Count(BiosVendor vendor)
+{
+    const size_t index = static_cast<size_t>(vendor);
+    return (index < CDB_TABLE.counts.size()) ? CDB_TABLE.counts[index] : 0;
+}
+
+const char* PostCodeDatabase::VendorName(BiosVendor vendor)
+{
+    switch (vendor) {
+    case BiosVendor::Ami:
+        return "AMI";
+    case BiosVendor::Award:
+        return "Award";
+    case BiosVendor::Phoenix:
+        return "Phoenix";
+    case BiosVendor::Ibm:
+        return "IBM";
+    case BiosVendor::Compaq:
+        return "Compaq";
+    default:
+        return "Off";
+    }
+}
+
+bool PostCodeDatabase::ParseVendor(std::string_view name, BiosVendor& vendor)
+{
+    auto sameName = [name](std::string_view known) {
+        return std::equal(name.begin(), name.end(), known.begin(), known.end(),
+            [](char lhs, char rhs) { return std::tolower(lhs) == std::tolower(rhs); });
+    };
+
+    for (uint8_t index = 0; index <= static_cast<uint8_t>(BiosVendor::Compaq); index++) {
+        const auto candidate = static_cast<BiosVendor>(index);
+        if (sameName(VendorName(candidate))) {
+            if (candidate != BiosVendor::None && Count(candidate) == 0) {
+                return false;
+            }
+            vendor = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file postcodes.hpp
+ * @brief What POST codes mean, per BIOS vendor.
+ *
+ */
+
+#ifndef PICOPOST_POSTCODES_HPP
+#define PICOPOST_POSTCODES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum class BiosVendor : uint8_t {
+    None, ///< No lookups, raw codes only
+    Ami,
+    Award,
+    Phoenix,
+    Ibm,
+    Compaq,
+};
+
+/**
+ * @brief POST code descriptions, looked up in O(1) from tables in flash.
+ *
+ * @par
+ * Tables come from the plain text files in cdb/, turned into an initializer
+ * list by CMake and then into a perfect hash at compile time: every vendor and
+ * code pair lands in a slot of its own, so a lookup is two hashes and a single
+ * compare, with no probing. Descriptions are kept once each in a shared string
+ * pool, slots only hold an offset into it. Nothing gets copied to RAM.
+ *
+ * @par
+ * PROJ_CDB_VER is the version of these tables.
+ */
+class PostCodeDatabase {
+public:
+    // Ports that carry POST codes, as opposed to debug consoles and such
+    static constexpr uint16_t c_postPorts[] { 0x80, 0x84, 0x90, 0x300, 0x378 };
+
+    /**
+     * @brief Description of a code, as sent by a vendor's BIOS.
+     *
+     * @return A short sentence, or nullptr if the code isn't in the tables
+     */
+    static const char* Describe(BiosVendor vendor, uint8_t code);
+
+    // Entries across all vendors
+    static size_t Count();
+    static size_t Count(BiosVendor vendor);
+
+    static const char* VendorName(BiosVendor vendor);
+
+    /**
+     * @brief Gets a vendor from its name, as in VendorName(), any case. "off"
+     * is BiosVendor::None. Vendors with no entries in the tables are left out,
+     * picking one would only turn descriptions off without saying so.
+     *
+     * @return false if the name is unknown or has no entries, vendor is left untouched
+     */
+    static bool ParseVendor(std::string_view name, BiosVendor& vendor);
+
+    static bool IsPostPort(uint16_t address)
+    {
+        for (const uint16_t port : c_postPorts) {
+            if (address == port) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif // PICOPOST_POSTCODES_HPP
@@ -0,0 +1,175 @@
+/**
+ * @file profiler.hpp
+ * @brief How long each POST code stayed on, for a single boot.
+ *
+ */
+
+#ifndef PICOPOST_PROFILER_HPP
+#define PICOPOST_PROFILER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief Per-code dwell times, built one POST code at a time.
+ *
+ * @par
+ * A code is active from the moment it gets written until a different one
+ * replaces it, so only changes matter and writes of the same value again are
+ * ignored. Each of the 256 codes keeps its total time on, its longest single
+ * stay and how many times it came back, and the order codes first showed up
+ * in is kept too, so the whole boot can be listed in sequence. All of it is
+ * fixed size, about 3 KB.
+ *
+ * @par
+ * Times are in us since reset deassertion, as handed out by the caller, so
+ * the first code's timestamp is also the reset-to-first-code latency. The
+ * code still active has no end yet: anything that reports on it takes the
+ * current time, and counts it as active up to then.
+ */
+class PostProfiler {
+public:
+    static constexpr size_t c_codes { 256 };
+
+    struct Stage {
+        uint8_t code { 0 };
+        uint16_t visits { 0 };
+        uint32_t totalUs { 0 }; // Saturated, a bit over an hour
+        uint32_t longestUs { 0 };
+    };
+
+    void Clear()
+    {
+        stages.fill({});
+        order.fill(0);
+        seen = 0;
+        current = -1;
+        since = 0;
+        firstAt = 0;
+        lastChangeUs = 0;
+        gaps = 0;
+    }
+
+    void Code(uint64_t atUs, uint8_t code)
+    {
+        if (current == code) {
+            return;
+        }
+        Close(atUs);
+
+        Stage& stage = stages[code];
+        if (stage.visits == 0) {
+            stage.code = code;
+            order[seen++] = code;
+        }
+        stage.visits = static_cast<uint16_t>(std::min<uint32_t>(stage.visits + 1u, UINT16_MAX));
+        current = code;
+        since = atUs;
+        lastChangeUs = atUs;
+    }
+
+    // Events were lost, the dwell times around here may be off
+    void MarkGap()
+    {
+        gaps++;
+    }
+
+    bool Empty() const
+    {
+        return seen == 0;
+    }
+
+    // Reset deassertion to the first code
+    uint64_t FirstCodeUs() const
+    {
+        return firstAt;
+    }
+
+    // Reset deassertion to the latest change of code
+    uint64_t LastCodeUs() const
+    {
+        return lastChangeUs;
+    }
+
+    uint32_t Gaps() const
+    {
+        return gaps;
+    }
+
+    /**
+     * @brief Stage of a code, with the active one counted up to nowUs.
+     */
+    Stage At(uint8_t code, uint64_t nowUs) const
+    {
+        Stage stage = stages[code];
+        if (current == code) {
+            Extend(stage, nowUs);
+        }
+        return stage;
+    }
+
+    // Calls visit(const Stage&) for every code seen, in order of appearance
+    template <typename Visit>
+    void ForEach(uint64_t nowUs, Visit&& visit) const
+    {
+        for (size_t idx = 0; idx < seen; idx++) {
+            visit(At(order[idx], nowUs));
+        }
+    }
+
+    /**
+     * @brief Fills slowest with the codes that were on the longest in total,
+     * slowest first.
+     *
+     * @return How many entries were filled
+     */
+    size_t Slowest(std::span<Stage> slowest, uint64_t nowUs) const
+    {
+        size_t filled = 0;
+        for (size_t idx = 0; idx < seen && !slowest.empty(); idx++) {
+            const Stage stage = At(order[idx], nowUs);
+            if (filled == slowest.size() && stage.totalUs <= slowest[filled - 1].totalUs) {
+                continue;
+            }
+            size_t pos = (filled < slowest.size()) ? filled++ : filled - 1;
+            while (pos > 0 && slowest[pos - 1].totalUs < stage.totalUs) {
+                slowest[pos] = slowest[pos - 1];
+                pos--;
+            }
+            slowest[pos] = stage;
+        }
+        return filled;
+    }
+
+private:
+    std::array<Stage, c_codes> stages {};
+    std::array<uint8_t, c_codes> order {};
+    size_t seen { 0 };
+    int16_t current { -1 }; // -1 before the first code
+    uint64_t since { 0 };
+    uint64_t firstAt { 0 };
+    uint64_t lastChangeUs { 0 };
+    uint32_t gaps { 0 };
+
+    void Close(uint64_t atUs)
+    {
+        if (current < 0) {
+            firstAt = atUs;
+            return;
+        }
+        Extend(stages[current], atUs);
+    }
+
+    // Adds the current stay, from since to atUs
+    void Extend(Stage& stage, uint64_t atUs) const
+    {
+        const uint32_t dwell = static_cast<uint32_t>(std::min<uint64_t>((atUs > since) ? atUs - since : 0, UINT32_MAX));
+        stage.totalUs = static_cast<uint32_t>(std::min<uint64_t>(uint64_t { stage.totalUs } + dwell, UINT32_MAX));
+        stage.longestUs = std::max(stage.longestUs, dwell);
+    }
+};
+
+#endif // PICOPOST_PROFILER_HPP
@@ -0,0 +1,90 @@
+/**
+ * @file spscring.hpp
+ * @brief Lock-free ring shared between the capture core and the UI core.
+ *
+ */
+
+#ifndef PICOPOST_SPSCRING_HPP
+#define PICOPOST_SPSCRING_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <span>
+
+/**
+ * @brief Single producer, single consumer ring, read in place.
+ *
+ * @par
+ * Heads are free-running counters, so telling a full ring from an empty one
+ * needs no extra flag, and each side only ever writes its own head. No locks,
+ * no spinlocks, no copies on the way out: the consumer gets a span pointing
+ * straight into the ring memory with Peek(), works on it, then hands the
+ * slots back with Release().
+ *
+ * @par
+ * "Single producer" means a single execution context at a time. On the
+ * capture core, ISRs sharing the same priority can't preempt each other, so
+ * they count as one; thread code pushing alongside them must mask interrupts.
+ */
+template <typename T, size_t Size>
+class SpscRing {
+    static_assert((Size & (Size - 1)) == 0, "Size must be a power of 2");
+
+public:
+    // Producer: insert an element. Returns false and drops the insertion if ring is full.
+    bool Push(const T& item)
+    {
+        const size_t currWriteHead = writeHead.load(std::memory_order_relaxed);
+        if (currWriteHead - readHead.load(std::memory_order_acquire) >= Size) {
+            return false;
+        }
+
+        buffer[currWriteHead & (Size - 1)] = item;
+        writeHead.store(currWriteHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer: room left for new elements
+    size_t Free() const
+    {
+        return Size - (writeHead.load(std::memory_order_relaxed) - readHead.load(std::memory_order_acquire));
+    }
+
+    // Consumer: number of elements waiting to be read
+    size_t Level() const
+    {
+        return writeHead.load(std::memory_order_acquire) - readHead.load(std::memory_order_relaxed);
+    }
+
+    // Consumer: oldest readable elements, up to the end of the underlying array.
+    // Call again after Release() to get the ones that wrapped around.
+    std::span<const T> Peek() const
+    {
+        const size_t currReadHead = readHead.load(std::memory_order_relaxed);
+        const size_t available = writeHead.load(std::memory_order_acquire) - currReadHead;
+        const size_t start = currReadHead & (Size - 1);
+
+        return { buffer.data() + start, std::min(available, Size - start) };
+    }
+
+    // Consumer: give back elements obtained from Peek()
+    void Release(size_t count)
+    {
+        readHead.store(readHead.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // Consumer: drop everything currently in the ring
+    void Clear()
+    {
+        readHead.store(writeHead.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    std::array<T, Size> buffer {};
+    std::atomic<size_t> writeHead { 0 }; // Producer (capture core)
+    std::atomic<size_t> readHead { 0 }; // Consumer (UI core)
+};
+
+#endif // PICOPOST_SPSCRING_HPP
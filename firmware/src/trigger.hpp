@@ -0,0 +1,148 @@
+/**
+ * @file trigger.hpp
+ * @brief Logic analyzer style trigger, evaluated on every captured event.
+ *
+ */
+
+#ifndef PICOPOST_TRIGGER_HPP
+#define PICOPOST_TRIGGER_HPP
+
+#include "common.hpp"
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief Sequence of conditions that must be met, in order, to fire.
+ *
+ * @par
+ * Each condition matches a single event: a write to a port (optionally with
+ * a given value), or a reset edge. Events in between conditions are ignored,
+ * so "80=2B,reset" fires on the first reset following a 2Bh POST code.
+ *
+ * @par
+ * Feed() runs for every event while armed, from ISRs too, so it's kept down
+ * to a couple of masked compares against the current stage.
+ *
+ * @par
+ * The textual form, used by the USB "trigger" command, is a comma separated
+ * list of stages: "PORT" (any write), "PORT=DATA" (hex), "reset" (asserted)
+ * and "clear" (released).
+ */
+class TriggerEngine {
+public:
+    static constexpr size_t c_maxStages { 4 };
+
+    struct Condition {
+        QueueOperation operation { QueueOperation::P80Data };
+        uint16_t address { 0 };
+        uint16_t addressMask { 0 }; // Zero matches any address
+        uint8_t data { 0 };
+        uint8_t dataMask { 0 }; // Zero matches any data
+
+        inline bool Matches(const BusEvent& event) const
+        {
+            return event.operation == operation
+                && ((event.address ^ address) & addressMask) == 0
+                && ((event.data ^ data) & dataMask) == 0;
+        }
+    };
+
+    void Clear()
+    {
+        count = 0;
+        stage = 0;
+    }
+
+    bool Empty() const
+    {
+        return count == 0;
+    }
+
+    // Appends a stage. Returns false if there's no room left.
+    bool Add(const Condition& condition)
+    {
+        if (count == c_maxStages) {
+            return false;
+        }
+        conditions[count++] = condition;
+        return true;
+    }
+
+    // Starts over from the first stage
+    void Rearm()
+    {
+        stage = 0;
+    }
+
+    // Returns true when the last stage gets matched
+    inline bool Feed(const BusEvent& event)
+    {
+        if (!conditions[stage].Matches(event)) {
+            return false;
+        }
+        return ++stage == count;
+    }
+
+    /**
+     * @brief Replaces the trigger with the stages listed in spec.
+     *
+     * @return false if spec is malformed, trigger is left untouched
+     */
+    bool Parse(std::string_view spec)
+    {
+        TriggerEngine parsed {};
+        while (!spec.empty()) {
+            const size_t comma = spec.find(',');
+            const std::string_view item = spec.substr(0, comma);
+            spec = (comma == std::string_view::npos) ? std::string_view {} : spec.substr(comma + 1);
+
+            Condition condition {};
+            if (item == "reset") {
+                condition.operation = QueueOperation::P80ResetActive;
+            } else if (item == "clear") {
+                condition.operation = QueueOperation::P80ResetCleared;
+            } else {
+                const size_t equals = item.find('=');
+                if (!ParseHex(item.substr(0, equals), condition.address)) {
+                    return false;
+                }
+                condition.addressMask = UINT16_MAX;
+                if (equals != std::string_view::npos) {
+                    uint16_t data = 0;
+                    if (!ParseHex(item.substr(equals + 1), data) || data > UINT8_MAX) {
+                        return false;
+                    }
+                    condition.data = static_cast<uint8_t>(data);
+                    condition.dataMask = UINT8_MAX;
+                }
+            }
+
+            if (!parsed.Add(condition)) {
+                return false;
+            }
+        }
+
+        if (parsed.Empty()) {
+            return false;
+        }
+        *this = parsed;
+        return true;
+    }
+
+private:
+    std::array<Condition, c_maxStages> conditions {};
+    size_t count { 0 };
+    size_t stage { 0 };
+
+    static bool ParseHex(std::string_view text, uint16_t& value)
+    {
+        const auto result = std::from_chars(text.data(), text.data() + text.size(), value, 16);
+        return !text.empty() && result.ec == std::errc {} && result.ptr == text.data() + text.size();
+    }
+};
+
+#endif // PICOPOST_TRIGGER_HPP
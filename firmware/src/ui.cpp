@@ -1,6 +1,7 @@
 #include "ui.hpp"
 
 #include "bitmaps.hpp"
+#include "captureclock.hpp"
 #include "pins.h"
 #include "proj.h"
 
@@ -9,7 +10,10 @@
 
 #include "hardware/gpio.h"
 #include "pico/rand.h"
+#include "pico/time.h"
 
+#include <algorithm>
+#include <array>
 #include <iomanip>
 #include <sstream>
 #include <stdio.h>
@@ -18,14 +22,61 @@
 
 using namespace pico_oled;
 
+// Copies as many whole words from text as fit in columns into line, and moves text past them
+static void NextLine(const char*& text, char* line, size_t columns)
+{
+    while (*text == ' ') {
+        text++;
+    }
+    size_t length = strlen(text);
+    if (length > columns) {
+        length = columns;
+        while (length > 0 && text[length] != ' ') {
+            length--;
+        }
+        if (length == 0) {
+            length = columns; // One word longer than a line, cut it
+        }
+    }
+    memcpy(line, text, length);
+    line[length] = '\0';
+    text += length;
+}
+
+// Short enough for the OLED: "1.23s", "12.3s", "123s"
+static void FormatSeconds(char* out, size_t size, uint32_t us)
+{
+    const uint32_t ms = us / 1000;
+    if (ms < 10000) {
+        snprintf(out, size, "%u.%02us", static_cast<uint>(ms / 1000), static_cast<uint>(ms % 1000 / 10));
+    } else if (ms < 100000) {
+        snprintf(out, size, "%u.%us", static_cast<uint>(ms / 1000), static_cast<uint>(ms % 1000 / 100));
+    } else {
+        snprintf(out, size, "%us", static_cast<uint>(ms / 1000));
+    }
+}
+
 const std::vector<MenuEntry> UserInterface::s_mainMenu = {
     { ProgramSelect::Port80Reader, "Port 80h std" },
     { ProgramSelect::Port84Reader, "Port 84h CPQ" },
     { ProgramSelect::Port90Reader, "Port 90h PS/2" },
     { ProgramSelect::Port300Reader, "Port 300h EISA" },
     { ProgramSelect::Port378Reader, "Port 378h Oli" },
+    { ProgramSelect::MultiPortReader, "Port 80h+84h" },
+    { ProgramSelect::CustomReader, "Custom filter" },
+    { ProgramSelect::WordReader, "16-bit codes" },
+    { ProgramSelect::ConsoleReader, "Consoles" },
+    { ProgramSelect::BeepReader, "Beep codes" },
+    { ProgramSelect::StageProfiler, "Stage timing" },
+    { ProgramSelect::GoldenMatch, "Golden boot" },
+    { ProgramSelect::BiosDetect, "Detect BIOS" },
+    { ProgramSelect::DeepCapture, "Deep capture" },
     { ProgramSelect::BusDump, "Bus dump" },
+    { ProgramSelect::CycleTiming, "IO timing" },
+    { ProgramSelect::PortHeatmap, "Port heatmap" },
     { ProgramSelect::VoltageMonitor, "Voltage rails" },
+    { ProgramSelect::BusClock, "Bus clock" },
+    { ProgramSelect::Calibration, "Calibrate bus" },
     { ProgramSelect::Info, "Info" },
     { ProgramSelect::UpdateFW, "Update FW" }
 };
@@ -170,56 +221,224 @@ void UserInterface::DrawMenu(uint index)
     display->sendBuffer();
 }
 
-void UserInterface::NewData(const QueueData* buffer, const size_t elements, const bool writeToOled)
+void UserInterface::NewData(const BusEvent* buffer, const size_t elements, const bool writeToOled)
 {
     if (buffer == nullptr || elements == 0) {
         return;
     }
 
-    // OLED data handler
-    enum class OLEDRefreshOperation {
-        None,
-        Volts,
-        Bus,
-    };
-
     OLEDRefreshOperation oledRefresh { OLEDRefreshOperation::None };
     std::stringstream serialBuff {};
+    auto showWord = [this, &serialBuff, &oledRefresh](const WordAssembler::Code& code) {
+        if (ShowWord(code, serialBuff)) {
+            oledRefresh = OLEDRefreshOperation::Words;
+        }
+    };
+    auto showConsole = [this, &serialBuff, &oledRefresh](ConsoleDecoder::Source source, const char* text) {
+        ShowConsole(source, text, serialBuff);
+        oledRefresh = OLEDRefreshOperation::Console;
+    };
+    auto showBeeps = [this, &serialBuff, &oledRefresh](const BeepDecoder::Pattern& pattern) {
+        ShowBeeps(pattern, serialBuff);
+        oledRefresh = OLEDRefreshOperation::Beeps;
+    };
+
     for (uint idx = 0; idx < elements; idx++) {
         const auto currItem = &buffer[idx];
+        m_busTime += currItem->delta;
+        if (m_wordsEnabled && currItem->operation != QueueOperation::P80Data) {
+            // A half code still waiting goes before whatever this is
+            m_words.Flush(showWord);
+        }
+        if (m_consoleEnabled && currItem->operation != QueueOperation::P80Data
+            && currItem->operation != QueueOperation::P80Repeat) {
+            m_console.Flush(showConsole);
+        }
         switch (currItem->operation) {
 
-        case QueueOperation::Volts: {
-            sprintf(textBuffer[0], "%01.2f", currItem->volts5);
-            sprintf(textBuffer[1], "%02.2f", currItem->volts12);
-            serialBuff << "5V @ " << textBuffer[0] << " | 12V @ " << textBuffer[1] << "\n";
-            oledRefresh = OLEDRefreshOperation::Volts;
-        } break;
-
         case QueueOperation::P80Data: {
-            if (currItem->data != m_lastData) {
-                const double tstampDbl = currItem->timestamp / 1000.0;
+            m_repeatPort = currItem->address;
+            m_repeatData = currItem->data;
+            if (m_beepsEnabled && m_beeps.Matches(currItem->address)) {
+                m_beeps.Feed(CaptureClock::ToMicros(m_busTime), currItem->address, currItem->data, showBeeps);
+                break;
+            }
+            if (m_consoleEnabled && m_console.Matches(currItem->address)) {
+                m_console.Feed(currItem->address, currItem->data, showConsole);
+                m_consoleFedAt = time_us_64();
+                break;
+            }
+            if (m_wordsEnabled && m_words.Matches(currItem->address)) {
+                m_words.Feed(m_busTime, CaptureClock::FromMicros(m_words.WindowUs()),
+                    currItem->address, currItem->data, showWord);
+                break;
+            }
+            if (m_fingerprintEnabled) {
+                if (m_fingerprint.Code(currItem->address, currItem->data)) {
+                    ShowFingerprint(serialBuff);
+                    oledRefresh = OLEDRefreshOperation::Fingerprint;
+                }
+                const auto& found = m_fingerprint.GetResult();
+                if (m_fingerprint.Done() && found.sure && currItem->address != found.port) {
+                    break; // Only the port the BIOS was found on matters from here
+                }
+            }
+            if (m_profilerEnabled) {
+                m_profiler.Code(CaptureClock::ToMicros(m_busTime), currItem->data);
+            }
+            if (m_goldenEnabled && m_golden.Code(CaptureClock::ToMicros(m_busTime), currItem->data)) {
+                ShowGolden(serialBuff);
+                oledRefresh = OLEDRefreshOperation::Golden;
+            }
+            const bool fresh = m_lanesEnabled
+                ? UpdateLane(currItem->address, currItem->data)
+                : (currItem->data != m_lastData);
+            if (fresh) {
+                const double tstampDbl = CaptureClock::ToMicros(m_busTime) / 1000.0;
                 HistoryShift();
                 sprintf(textBuffer[0], "%02X", currItem->data);
                 serialBuff << std::setw(10) << std::fixed << std::setprecision(3) << tstampDbl << " | ";
                 serialBuff << textBuffer[0] << " @ ";
-                serialBuff << std::setw(4) << std::setfill('0') << std::hex << currItem->address << std::setfill(' ') << "h\n";
+                serialBuff << std::setw(4) << std::setfill('0') << std::hex << currItem->address << std::setfill(' ') << "h";
+                if (PostCodeDatabase::IsPostPort(currItem->address)) {
+                    m_codeText = PostCodeDatabase::Describe(m_codeVendor, currItem->data);
+                }
+                if (m_codeText != nullptr) {
+                    serialBuff << " | " << m_codeText;
+                }
+                serialBuff << "\n";
                 m_lastData = currItem->data;
-                oledRefresh = OLEDRefreshOperation::Bus;
+                if (m_profilerEnabled) {
+                    UpdateProfile();
+                }
+                oledRefresh = HistoryView();
             }
         } break;
 
+        case QueueOperation::P80Repeat: {
+            // Folded writes still matter to decoders: console text, PIT byte order
+            if (m_consoleEnabled && m_console.Matches(m_repeatPort)) {
+                for (uint count = 0; count < currItem->address; count++) {
+                    m_console.Feed(m_repeatPort, m_repeatData, showConsole);
+                }
+                m_consoleFedAt = time_us_64();
+                break;
+            }
+            if (m_beepsEnabled && m_beeps.Matches(m_repeatPort)) {
+                // Same value every time, only whether the LSB/MSB toggle ends up flipped counts
+                if (currItem->address & 1) {
+                    m_beeps.Feed(CaptureClock::ToMicros(m_busTime), m_repeatPort, m_repeatData, showBeeps);
+                }
+                break;
+            }
+
+            // Display already shows the value, only serial gets to know how long it went on
+            const double tstampDbl = CaptureClock::ToMicros(m_busTime) / 1000.0;
+            serialBuff << std::setw(10) << std::fixed << std::setprecision(3) << tstampDbl << " | ";
+            serialBuff << "Repeated " << std::dec << currItem->address << " more times\n";
+        } break;
+
         case QueueOperation::P80ResetActive:
         case QueueOperation::P80ResetCleared: {
             HistoryShift();
             if (currItem->operation == QueueOperation::P80ResetActive) {
+                // Bus time starts over, and so does the host
+                m_beeps.Flush(showBeeps);
+                m_beeps.Reset();
+                m_console.Reset();
+                if (m_fingerprintEnabled) {
+                    m_fingerprint.Reset();
+                    strcpy(m_fingerprintText, "Detecting...");
+                }
+                if (m_profilerEnabled && !m_profiler.Empty()) {
+                    ReportProfile(CaptureClock::ToMicros(m_busTime), serialBuff);
+                }
                 serialBuff << "Reset asserted!\n";
                 sprintf(textBuffer[0], "R!");
+                if (m_goldenEnabled && m_golden.ResetAsserted()) {
+                    ShowGolden(serialBuff);
+                }
             } else {
-                serialBuff << "Reset cleared\n";
+                const uint32_t widthUs = currItem->address | (static_cast<uint32_t>(currItem->data) << 16);
+                serialBuff << "Reset cleared, held for " << std::dec << std::fixed << std::setprecision(3)
+                           << (widthUs / 1000.0) << (widthUs >= c_maxPulseWidth ? "+" : "") << " ms\n";
                 sprintf(textBuffer[0], "R_");
+                if (m_goldenEnabled && m_golden.ResetCleared()) {
+                    ShowGolden(serialBuff);
+                }
+            }
+            m_lastData = 0x0100;
+            m_lastWord = UINT32_MAX;
+            m_busTime = 0;
+            m_profiler.Clear(); // OLED keeps showing the last boot until the next code
+            for (size_t lane = 0; lane < m_laneCount; lane++) {
+                m_laneData[lane] = 0x0100;
+                strcpy(m_laneText[lane], textBuffer[0]);
             }
+            oledRefresh = HistoryView();
+        } break;
+
+        case QueueOperation::P80Trigger: {
+            HistoryShift();
+            sprintf(textBuffer[0], "T!");
+            serialBuff << "Trigger!\n";
+            oledRefresh = HistoryView();
+        } break;
+
+        case QueueOperation::P80Gap: {
+            m_profiler.MarkGap();
+            if (m_goldenEnabled && m_golden.MarkGap()) {
+                ShowGolden(serialBuff);
+            }
+            HistoryShift();
+            sprintf(textBuffer[0], "--");
+            serialBuff << "Gap, " << std::dec << currItem->address << " events lost:";
+            if (currItem->data & LS_PioStall) {
+                serialBuff << " PIO stall";
+            }
+            if (currItem->data & LS_CaptureBuffer) {
+                serialBuff << " DMA overrun";
+            }
+            if (currItem->data & LS_EventRing) {
+                serialBuff << " ring full";
+            }
+            if (currItem->data & LS_Display) {
+                serialBuff << " skipped by UI";
+            }
+            if (currItem->data & LS_FlashLog) {
+                serialBuff << " flash log full";
+            }
+            serialBuff << "\n";
             m_lastData = 0x0100;
+            m_lastWord = UINT32_MAX;
+            oledRefresh = HistoryView();
+        } break;
+
+        case QueueOperation::CalibrationStep: {
+            HistoryShift();
+            serialBuff << "Dead time " << std::dec << std::setw(4) << currItem->address << " ns -> ";
+            if (currItem->data == c_calibNoTraffic) {
+                sprintf(textBuffer[0], "??");
+                serialBuff << "bus too quiet\n";
+            } else if (currItem->data == 0) {
+                sprintf(textBuffer[0], "OK");
+                serialBuff << "OK\n";
+            } else {
+                sprintf(textBuffer[0], "KO");
+                serialBuff << static_cast<uint>(currItem->data) << " torn samples\n";
+            }
+            oledRefresh = OLEDRefreshOperation::Bus;
+        } break;
+
+        case QueueOperation::CalibrationDone: {
+            HistoryShift();
+            if (currItem->address != 0) {
+                sprintf(textBuffer[0], "C!");
+                serialBuff << "Calibration OK! -> " << std::dec << currItem->address << " ns dead time per cycle\n";
+            } else {
+                sprintf(textBuffer[0], "C?");
+                serialBuff << "Calibration KO! -> Timings left unchanged\n";
+            }
             oledRefresh = OLEDRefreshOperation::Bus;
         } break;
 
@@ -228,10 +447,140 @@ void UserInterface::NewData(const QueueData* buffer, const size_t elements, cons
         } break;
         }
     }
+    m_busSeenAt = time_us_64();
+
+    printf("%s", serialBuff.str().c_str());
+
+    if (writeToOled) {
+        RefreshOled(oledRefresh);
+    }
+}
+
+size_t UserInterface::SkipData(const BusEvent* buffer, const size_t elements, const bool reportGap)
+{
+    size_t skipped = 0;
+    size_t pending = 0;
+    auto flushGap = [this, &pending, reportGap]() {
+        if (reportGap && pending > 0) {
+            const BusEvent gap {
+                .address = static_cast<uint16_t>(std::min<size_t>(pending, UINT16_MAX)),
+                .data = LS_Display,
+                .operation = QueueOperation::P80Gap,
+            };
+            NewData(&gap, 1);
+            pending = 0;
+        }
+    };
+
+    for (uint idx = 0; idx < elements; idx++) {
+        const auto currItem = &buffer[idx];
+        if (currItem->operation == QueueOperation::P80Data || currItem->operation == QueueOperation::P80Repeat) {
+            m_busTime += currItem->delta;
+            const size_t events = (currItem->operation == QueueOperation::P80Repeat) ? currItem->address : 1;
+            skipped += events;
+            pending += events;
+        } else if (!reportGap) {
+            // Only the clock matters here
+            const bool reset = (currItem->operation == QueueOperation::P80ResetActive
+                || currItem->operation == QueueOperation::P80ResetCleared);
+            m_busTime = reset ? 0 : (m_busTime + currItem->delta);
+        } else {
+            // Resets and other gaps are worth more than a few lost POST codes
+            flushGap();
+            NewData(currItem, 1);
+        }
+    }
+    flushGap();
+
+    return skipped;
+}
+
+void UserInterface::NewData(const VoltageSample* buffer, const size_t elements, const bool writeToOled)
+{
+    if (buffer == nullptr || elements == 0) {
+        return;
+    }
+
+    std::stringstream serialBuff {};
+    for (uint idx = 0; idx < elements; idx++) {
+        sprintf(textBuffer[0], "%01.2f", buffer[idx].volts5);
+        sprintf(textBuffer[1], "%02.2f", buffer[idx].volts12);
+        serialBuff << "5V @ " << textBuffer[0] << " | 12V @ " << textBuffer[1] << "\n";
+    }
+
+    printf("%s", serialBuff.str().c_str());
+
+    if (writeToOled) {
+        RefreshOled(OLEDRefreshOperation::Volts);
+    }
+}
+
+void UserInterface::NewData(const ClockSample* buffer, const size_t elements, const bool writeToOled)
+{
+    if (buffer == nullptr || elements == 0) {
+        return;
+    }
+
+    std::stringstream serialBuff {};
+    for (uint idx = 0; idx < elements; idx++) {
+        const auto& sample = buffer[idx];
+        if (sample.frequencyHz == 0) {
+            sprintf(textBuffer[0], "No clock");
+            sprintf(textBuffer[1], "--");
+            serialBuff << "BCLK stopped\n";
+            continue;
+        }
+
+        sprintf(textBuffer[0], "%lu.%03lu MHz", static_cast<unsigned long>(sample.frequencyHz / 1000000),
+            static_cast<unsigned long>(sample.frequencyHz / 1000 % 1000));
+        sprintf(textBuffer[1], "%u ns", static_cast<uint>(sample.maxPeriodNs - sample.minPeriodNs));
+        serialBuff << "BCLK @ " << std::dec << sample.frequencyHz << " Hz | Period " << sample.minPeriodNs
+                   << "-" << sample.maxPeriodNs << " ns\n";
+    }
+
+    printf("%s", serialBuff.str().c_str());
+
+    if (writeToOled) {
+        RefreshOled(OLEDRefreshOperation::Clock);
+    }
+}
+
+void UserInterface::NewData(const PortHeatmap::Entry* buffer, const size_t elements, const uint32_t total,
+    const bool writeToOled)
+{
+    if (buffer == nullptr || total == 0) {
+        return;
+    }
+
+    // Columns on the OLED: device name, port, share of all writes
+    memset(textBuffer, '\0', sizeof(textBuffer));
+    std::stringstream serialBuff {};
+    serialBuff << "Heatmap -> " << std::dec << total << " writes\n";
+    for (uint idx = 0; idx < elements; idx++) {
+        const auto& entry = buffer[idx];
+        const char* name = PortHeatmap::DeviceName(entry.address);
+        const uint percent = static_cast<uint>(uint64_t { entry.count } * 100 / total);
+        if (idx < c_heatmapColumns) {
+            sprintf(textBuffer[idx], "%s", (name != nullptr) ? name : "?");
+            sprintf(textBuffer[c_heatmapColumns + idx], "%Xh", entry.address);
+            sprintf(textBuffer[2 * c_heatmapColumns + idx], "%u%%", percent);
+        }
+        serialBuff << std::setw(4) << std::setfill('0') << std::hex << entry.address
+                   << std::setfill(' ') << "h " << std::setw(5) << std::left << ((name != nullptr) ? name : "?")
+                   << std::right << " | " << std::dec << std::setw(10) << entry.count << " | " << std::setw(3)
+                   << percent << "%\n";
+    }
 
     printf("%s", serialBuff.str().c_str());
 
-    if (writeToOled && display != nullptr && oledRefresh != OLEDRefreshOperation::None) {
+    if (writeToOled) {
+        RefreshOled(OLEDRefreshOperation::Heatmap);
+    }
+}
+
+void UserInterface::RefreshOled(OLEDRefreshOperation oledRefresh)
+{
+    if (display != nullptr && oledRefresh != OLEDRefreshOperation::None) {
         const uint8_t bottomOffsetSmall = displayHeight - 1 - 13;
         const uint8_t bottomOffsetLarge = bottomOffsetSmall - 4;
         const uint8_t centerOffsetSmall = bottomOffsetSmall - 16;
@@ -250,6 +599,89 @@ void UserInterface::NewData(const QueueData* buffer, const size_t elements, cons
                     textBuffer[idx], horzOffset, (idx == 0) ? vertOffset - 4 : vertOffset);
                 horzOffset -= itemSpace;
             }
+            DrawDescription(c_describeColumns);
+        } break;
+
+        case OLEDRefreshOperation::Words: {
+            // Four digits per code leave room for two older ones
+            fillRect(display, 0, 12, 127, displayHeight - 1, WriteMode::SUBTRACT);
+            const uint8_t vertOffset = (displayHeight == 64) ? topOffsetSmall : bottomOffsetSmall;
+            drawText(display, font_12x16, textBuffer[0], 70, vertOffset - 4);
+            drawText(display, font_8x8, textBuffer[1], 34, vertOffset);
+            drawText(display, font_8x8, textBuffer[2], 0, vertOffset);
+        } break;
+
+        case OLEDRefreshOperation::Lanes: {
+            fillRect(display, 0, 12, c_ui_yIconAlign - 1, displayHeight - 1, WriteMode::SUBTRACT);
+            const uint8_t laneWidth = c_ui_yIconAlign / c_maxLanes;
+            char portLabel[c_maxStrlen];
+            for (size_t lane = 0; lane < m_laneCount; lane++) {
+                const uint8_t horzOffset = static_cast<uint8_t>(lane * laneWidth);
+                sprintf(portLabel, "%Xh", m_lanePort[lane]);
+                drawText(display, font_5x8, portLabel, horzOffset, 13);
+                if (displayHeight == 64) {
+                    drawText(display, font_12x16, m_laneText[lane], horzOffset, 25);
+                } else {
+                    drawText(display, font_8x8, m_laneText[lane], horzOffset, 23);
+                }
+            }
+        } break;
+
+        case OLEDRefreshOperation::Heatmap: {
+            fillRect(display, 0, 12, c_ui_yIconAlign - 1, displayHeight - 1, WriteMode::SUBTRACT);
+            const uint8_t columnWidth = c_ui_yIconAlign / c_heatmapColumns;
+            for (size_t column = 0; column < c_heatmapColumns; column++) {
+                const uint8_t horzOffset = static_cast<uint8_t>(column * columnWidth);
+                drawText(display, font_5x8, textBuffer[column], horzOffset, 13);
+                drawText(display, font_8x8, textBuffer[c_heatmapColumns + column], horzOffset, 23);
+                if (displayHeight == 64) {
+                    drawText(display, font_5x8, textBuffer[2 * c_heatmapColumns + column], horzOffset, 35);
+                }
+            }
+        } break;
+
+        case OLEDRefreshOperation::Beeps: {
+            // Pattern on top, latest POST codes below it
+            fillRect(display, 0, 12, c_ui_yIconAlign - 1, displayHeight - 1, WriteMode::SUBTRACT);
+            drawText(display, font_5x8, (m_beepText[0] != '\0') ? m_beepText : "No beeps", 0, 13);
+            uint8_t horzOffset = 96;
+            for (uint8_t idx = 0; idx < 5; idx++) {
+                drawText(display, font_8x8, textBuffer[idx], horzOffset, 23);
+                horzOffset -= 24;
+            }
+        } break;
+
+        case OLEDRefreshOperation::Fingerprint: {
+            // Same as beep codes, the BIOS on top and the latest POST codes below
+            fillRect(display, 0, 12, c_ui_yIconAlign - 1, displayHeight - 1, WriteMode::SUBTRACT);
+            drawText(display, font_5x8, m_fingerprintText, 0, 13);
+            uint8_t horzOffset = 96;
+            for (uint8_t idx = 0; idx < 5; idx++) {
+                drawText(display, font_8x8, textBuffer[idx], horzOffset, 23);
+                horzOffset -= 24;
+            }
+            DrawDescription(c_consoleColumns);
+        } break;
+
+        case OLEDRefreshOperation::Profile: {
+            fillRect(display, 0, 12, c_ui_yIconAlign - 1, displayHeight - 1, WriteMode::SUBTRACT);
+            drawText(display, font_5x8, m_profileText[0], 0, 13);
+            const size_t rows = (displayHeight == 64) ? c_profileRows : 1;
+            for (size_t row = 0; row < rows; row++) {
+                drawText(display, font_5x8, m_profileText[row + 1], 0, static_cast<uint8_t>(23 + row * 10));
+            }
+        } break;
+
+        case OLEDRefreshOperation::Golden: {
+            fillRect(display, 0, 12, c_ui_yIconAlign - 1, displayHeight - 1, WriteMode::SUBTRACT);
+            drawText(display, font_8x8, m_goldenText[0], 0, 12);
+            drawText(display, font_5x8, m_goldenText[1], 0, 23);
+        } break;
+
+        case OLEDRefreshOperation::Console: {
+            fillRect(display, 0, 12, c_ui_yIconAlign - 1, displayHeight - 1, WriteMode::SUBTRACT);
+            drawText(display, font_5x8, textBuffer[0], 0, 13);
+            drawText(display, font_5x8, m_consoleText, 0, 23);
         } break;
 
         case OLEDRefreshOperation::Volts: {
@@ -268,6 +700,23 @@ void UserInterface::NewData(const QueueData* buffer, const size_t elements, cons
                 drawText(display, font_8x8, textBuffer[1], 67, 23);
             }
         } break;
+
+        case OLEDRefreshOperation::Clock: {
+            fillRect(display, 0, 9, c_ui_yIconAlign - 1, displayHeight - 1, WriteMode::SUBTRACT);
+            if (displayHeight == 32) {
+                drawText(display, font_5x8, "BCLK", 2, 9);
+                drawText(display, font_8x8, textBuffer[0], 2, bottomOffsetSmall);
+
+                drawText(display, font_5x8, "Jitter", 84, 9);
+                drawText(display, font_5x8, textBuffer[1], 84, bottomOffsetSmall);
+            } else if (displayHeight == 64) {
+                drawText(display, font_5x8, "BCLK", 4, 11);
+                drawText(display, font_8x8, textBuffer[0], 4, 23);
+
+                drawText(display, font_5x8, "Jitter p-p", 4, 37);
+                drawText(display, font_8x8, textBuffer[1], 4, 49);
+            }
+        } break;
         }
 
         display->sendBuffer();
@@ -277,7 +726,379 @@ void UserInterface::NewData(const QueueData* buffer, const size_t elements, cons
 void UserInterface::ClearBuffers()
 {
     m_lastData = 0x0100;
+    m_lastWord = UINT32_MAX;
+    m_busTime = 0;
+    m_laneCount = 0;
+    m_consoleText[0] = '\0';
+    m_beepText[0] = '\0';
+    m_codeText = nullptr;
     memset(textBuffer, '\0', sizeof(textBuffer));
+    memset(m_laneText, '\0', sizeof(m_laneText));
+}
+
+void UserInterface::SetLanes(bool enabled)
+{
+    m_lanesEnabled = enabled;
+    m_laneCount = 0;
+}
+
+UserInterface::OLEDRefreshOperation UserInterface::HistoryView() const
+{
+    if (m_lanesEnabled) {
+        return OLEDRefreshOperation::Lanes;
+    }
+    if (m_beepsEnabled) {
+        return OLEDRefreshOperation::Beeps;
+    }
+    if (m_fingerprintEnabled) {
+        return OLEDRefreshOperation::Fingerprint;
+    }
+    if (m_profilerEnabled) {
+        return OLEDRefreshOperation::Profile;
+    }
+    if (m_goldenEnabled) {
+        return OLEDRefreshOperation::Golden;
+    }
+    return m_wordsEnabled ? OLEDRefreshOperation::Words : OLEDRefreshOperation::Bus;
+}
+
+void UserInterface::SetWords(bool enabled, const WordAssembler& config)
+{
+    m_wordsEnabled = enabled;
+    m_words = config;
+    m_words.Reset();
+    m_lastWord = UINT32_MAX;
+}
+
+void UserInterface::SetConsole(bool enabled)
+{
+    m_consoleEnabled = enabled;
+    m_console.Reset();
+    m_consoleText[0] = '\0';
+}
+
+void UserInterface::ExpirePending()
+{
+    if (!m_wordsEnabled && !m_consoleEnabled && !m_beepsEnabled && !m_goldenEnabled) {
+        return;
+    }
+
+    OLEDRefreshOperation oledRefresh { OLEDRefreshOperation::None };
+    std::stringstream serialBuff {};
+    if (m_wordsEnabled) {
+        // The other half may still be on its way, even with the ring drained
+        m_words.Expire(CaptureClock::FromMicros(BusNowUs()), CaptureClock::FromMicros(m_words.WindowUs()),
+            [this, &serialBuff, &oledRefresh](const WordAssembler::Code& code) {
+                if (ShowWord(code, serialBuff)) {
+                    oledRefresh = OLEDRefreshOperation::Words;
+                }
+            });
+    }
+    if (m_consoleEnabled && m_console.Pending() && time_us_64() - m_consoleFedAt >= c_consoleIdleUs) {
+        m_console.Flush([this, &serialBuff, &oledRefresh](ConsoleDecoder::Source source, const char* text) {
+            ShowConsole(source, text, serialBuff);
+            oledRefresh = OLEDRefreshOperation::Console;
+        });
+    }
+    if (m_beepsEnabled) {
+        // Bus time stands still when the bus is quiet, which is exactly when beep codes end
+        m_beeps.Expire(BusNowUs(), [this, &serialBuff, &oledRefresh](const BeepDecoder::Pattern& pattern) {
+            ShowBeeps(pattern, serialBuff);
+            oledRefresh = OLEDRefreshOperation::Beeps;
+        });
+    }
+    if (m_goldenEnabled && m_golden.Check(BusNowUs())) {
+        // No need to wait for the next code to know this stage is too slow
+        ShowGolden(serialBuff);
+        oledRefresh = OLEDRefreshOperation::Golden;
+    }
+    printf("%s", serialBuff.str().c_str());
+    RefreshOled(oledRefresh);
+}
+
+void UserInterface::SetProfiler(bool enabled)
+{
+    m_profilerEnabled = enabled;
+    m_profiler.Clear();
+    memset(m_profileText, '\0', sizeof(m_profileText));
+}
+
+void UserInterface::PrintProfile()
+{
+    std::stringstream serialBuff {};
+    ReportProfile(BusNowUs(), serialBuff);
+    printf("%s", serialBuff.str().c_str());
+}
+
+void UserInterface::ReportProfile(uint64_t nowUs, std::stringstream& serialBuff)
+{
+    // Whole boot in order of appearance, times in ms
+    serialBuff << "Profile -> Reset to first code " << std::dec << std::fixed << std::setprecision(3)
+               << (m_profiler.FirstCodeUs() / 1000.0) << " ms | To last code " << (m_profiler.LastCodeUs() / 1000.0)
+               << " ms | " << m_profiler.Gaps() << " gaps\n";
+    serialBuff << "Code | Visits |   Total ms | Longest ms\n";
+    m_profiler.ForEach(nowUs, [&serialBuff](const PostProfiler::Stage& stage) {
+        serialBuff << " " << std::setw(2) << std::setfill('0') << std::hex << std::uppercase << +stage.code
+                   << std::nouppercase << std::setfill(' ') << "h | " << std::dec << std::setw(6) << stage.visits
+                   << " | " << std::setw(10) << (stage.totalUs / 1000.0) << " | " << std::setw(10)
+                   << (stage.longestUs / 1000.0) << "\n";
+    });
+}
+
+void UserInterface::UpdateProfile()
+{
+    // Summary, then the slowest stages two per row
+    std::array<PostProfiler::Stage, 2 * c_profileRows> slowest {};
+    const uint64_t nowUs = CaptureClock::ToMicros(m_busTime);
+    const size_t count = m_profiler.Slowest(slowest, nowUs);
+    char first[8];
+    char last[8];
+    FormatSeconds(first, sizeof(first), static_cast<uint32_t>(m_profiler.FirstCodeUs()));
+    FormatSeconds(last, sizeof(last), static_cast<uint32_t>(m_profiler.LastCodeUs()));
+    snprintf(m_profileText[0], sizeof(m_profileText[0]), "1st %s Tot %s", first, last);
+    for (size_t row = 0; row < c_profileRows; row++) {
+        char* text = m_profileText[row + 1];
+        text[0] = '\0';
+        for (size_t col = 0; col < 2 && 2 * row + col < count; col++) {
+            const auto& stage = slowest[2 * row + col];
+            char dwell[8];
+            FormatSeconds(dwell, sizeof(dwell), stage.totalUs);
+            const size_t used = strlen(text);
+            snprintf(text + used, sizeof(m_profileText[0]) - used, (col == 0) ? "%02X %-7s" : " %02X %s", stage.code, dwell);
+        }
+    }
+}
+
+void UserInterface::SetGolden(bool enabled)
+{
+    // Either way, a recording or a run in progress is over
+    m_goldenEnabled = enabled;
+    m_golden.ResetAsserted();
+    if (enabled) {
+        RefreshGolden();
+    }
+}
+
+GoldenMatcher& UserInterface::GetGolden()
+{
+    return m_golden;
+}
+
+void UserInterface::RefreshGolden()
+{
+    std::stringstream serialBuff {};
+    ShowGolden(serialBuff);
+    printf("%s", serialBuff.str().c_str());
+    if (m_goldenEnabled) {
+        RefreshOled(OLEDRefreshOperation::Golden);
+    }
+}
+
+void UserInterface::ShowGolden(std::stringstream& serialBuff)
+{
+    using State = GoldenMatcher::State;
+    using Failure = GoldenMatcher::Failure;
+    const auto& status = m_golden.GetStatus();
+    const uint steps = static_cast<uint>(m_golden.Reference().size());
+    const uint step = static_cast<uint>(status.step);
+    char* summary = m_goldenText[0];
+    char* detail = m_goldenText[1];
+    const size_t size = sizeof(m_goldenText[0]);
+    detail[0] = '\0';
+
+    switch (status.state) {
+    case State::Empty: {
+        snprintf(summary, size, "No reference");
+        snprintf(detail, size, "golden record");
+    } break;
+
+    case State::Armed: {
+        snprintf(summary, size, "Armed");
+        snprintf(detail, size, "Reset to record");
+    } break;
+
+    case State::Recording: {
+        snprintf(summary, size, "REC %u", step);
+    } break;
+
+    case State::Waiting: {
+        snprintf(summary, size, "Ready %u", steps);
+        snprintf(detail, size, "Reset to check");
+    } break;
+
+    case State::Running: {
+        snprintf(summary, size, "RUN %u/%u", step, steps);
+        snprintf(detail, size, "Next %02Xh", status.expected);
+    } break;
+
+    case State::Pass: {
+        snprintf(summary, size, "PASS %u/%u", step, steps);
+    } break;
+
+    case State::Fail: {
+        snprintf(summary, size, "FAIL %u/%u", step, steps);
+        if (status.failure == Failure::Diverged) {
+            snprintf(detail, size, "Got %02Xh, want %02Xh", status.got, status.expected);
+        } else if (status.failure == Failure::Missing) {
+            snprintf(detail, size, "Missing %02Xh", status.expected);
+        } else if (status.failure == Failure::Slow) {
+            char took[8];
+            char limit[8];
+            FormatSeconds(took, sizeof(took), status.tookUs);
+            FormatSeconds(limit, sizeof(limit), status.limitUs);
+            snprintf(detail, size, "%02Xh %s>%s", status.expected, took, limit);
+        } else {
+            snprintf(detail, size, "Too many codes");
+        }
+    } break;
+
+    case State::Inconclusive: {
+        // Lost on our side, the board may well be fine
+        if (steps > 0) {
+            snprintf(summary, size, "N/A %u/%u", step, steps);
+            snprintf(detail, size, "Events lost");
+        } else {
+            snprintf(summary, size, "REC dropped");
+            snprintf(detail, size, "Events lost");
+        }
+    } break;
+    }
+
+    // Step by step progress is already in the POST code output
+    if (status.state != State::Running || step == 0) {
+        serialBuff << "Golden -> " << summary << ((detail[0] != '\0') ? " | " : "") << detail << "\n";
+    }
+}
+
+void UserInterface::PrintGolden()
+{
+    const auto reference = m_golden.Reference();
+    printf("Golden -> %u codes | Stages up to %u%% slower, plus %u ms\n", static_cast<uint>(reference.size()),
+        static_cast<uint>(m_golden.TolerancePct()), static_cast<uint>(m_golden.SlackUs() / 1000));
+    for (const auto& step : reference) {
+        printf("%02Xh @ %10.3f ms\n", step.code, step.atUs / 1000.0);
+    }
+}
+
+uint64_t UserInterface::BusNowUs() const
+{
+    // Bus time stands still while the bus is quiet, the CPU timer doesn't
+    return CaptureClock::ToMicros(m_busTime) + (time_us_64() - m_busSeenAt);
+}
+
+void UserInterface::SetCodeDatabase(BiosVendor vendor)
+{
+    m_codeVendor = vendor;
+}
+
+BiosVendor UserInterface::GetCodeDatabase() const
+{
+    return m_codeVendor;
+}
+
+void UserInterface::SetFingerprint(bool enabled)
+{
+    m_fingerprintEnabled = enabled;
+    m_fingerprint.Reset();
+    strcpy(m_fingerprintText, "Detecting...");
+}
+
+void UserInterface::ShowFingerprint(std::stringstream& serialBuff)
+{
+    const auto& found = m_fingerprint.GetResult();
+    const double tstampDbl = CaptureClock::ToMicros(m_busTime) / 1000.0;
+    serialBuff << std::setw(10) << std::fixed << std::setprecision(3) << tstampDbl << " | BIOS: ";
+    if (found.vendor == BiosVendor::None) {
+        strcpy(m_fingerprintText, "Unknown BIOS");
+        serialBuff << "unknown after " << std::dec << static_cast<uint>(m_fingerprint.Seen()) << " codes\n";
+        return;
+    }
+
+    const char* vendor = PostCodeDatabase::VendorName(found.vendor);
+    if (found.sure) {
+        snprintf(m_fingerprintText, sizeof(m_fingerprintText), "%s %s @%Xh", vendor, found.version, found.port);
+        m_codeVendor = found.vendor;
+    } else {
+        // Not worth switching descriptions over
+        snprintf(m_fingerprintText, sizeof(m_fingerprintText), "%s %s?", vendor, found.version);
+    }
+    serialBuff << (found.sure ? "" : "maybe ") << vendor << " " << found.version << " on " << std::hex
+               << std::setw(4) << std::setfill('0') << found.port << std::setfill(' ') << "h, score " << std::dec
+               << found.score;
+    if (found.sure) {
+        serialBuff << " -> " << vendor << " descriptions";
+    }
+    serialBuff << "\n";
+}
+
+void UserInterface::DrawDescription(size_t columns)
+{
+    // Only 64 px displays have room left below the history
+    if (displayHeight != 64 || m_codeText == nullptr) {
+        return;
+    }
+    const char* text = m_codeText;
+    char line[c_describeColumns + 1];
+    columns = (columns < c_describeColumns) ? columns : c_describeColumns;
+    for (uint8_t row = 0; row < c_describeRows && *text != '\0'; row++) {
+        NextLine(text, line, columns);
+        drawText(display, font_5x8, line, 0, 36 + row * 9);
+    }
+}
+
+void UserInterface::SetBeeps(bool enabled)
+{
+    m_beepsEnabled = enabled;
+    m_beeps.Reset();
+    m_beepText[0] = '\0';
+}
+
+void UserInterface::ShowBeeps(const BeepDecoder::Pattern& pattern, std::stringstream& serialBuff)
+{
+    BeepDecoder::Describe(pattern, m_beepText, sizeof(m_beepText));
+    const double tstampDbl = CaptureClock::ToMicros(m_busTime) / 1000.0;
+    serialBuff << std::setw(10) << std::fixed << std::setprecision(3) << tstampDbl << " | ";
+    serialBuff << "Beeps: " << m_beepText << " @ " << std::dec << pattern.beeps[0].frequencyHz << " Hz |";
+    for (size_t idx = 0; idx < pattern.count; idx++) {
+        serialBuff << " " << (pattern.beeps[idx].lengthUs / 1000);
+    }
+    serialBuff << " ms\n";
+}
+
+void UserInterface::ShowConsole(ConsoleDecoder::Source source, const char* text, std::stringstream& serialBuff)
+{
+    const double tstampDbl = CaptureClock::ToMicros(m_busTime) / 1000.0;
+    serialBuff << std::setw(10) << std::fixed << std::setprecision(3) << tstampDbl << " | ";
+    serialBuff << std::setw(4) << std::left << ConsoleDecoder::SourceName(source) << std::right << " | " << text << "\n";
+
+    // OLED only fits the start of the latest line
+    strncpy(textBuffer[0], ConsoleDecoder::SourceName(source), c_maxStrlen - 1);
+    strncpy(m_consoleText, text, c_consoleColumns);
+    m_consoleText[c_consoleColumns] = '\0';
+}
+
+bool UserInterface::ShowWord(const WordAssembler::Code& code, std::stringstream& serialBuff)
+{
+    const uint32_t key = code.value | (code.haveLow ? 0x10000 : 0) | (code.haveHigh ? 0x20000 : 0);
+    if (key == m_lastWord) {
+        return false;
+    }
+    m_lastWord = key;
+
+    // Missing halves show as dashes
+    HistoryShift();
+    if (code.haveLow && code.haveHigh) {
+        sprintf(textBuffer[0], "%04X", code.value);
+    } else if (code.haveHigh) {
+        sprintf(textBuffer[0], "%02X--", code.value >> 8);
+    } else {
+        sprintf(textBuffer[0], "--%02X", code.value & 0xFF);
+    }
+    const double tstampDbl = CaptureClock::ToMicros(m_busTime) / 1000.0;
+    serialBuff << std::setw(10) << std::fixed << std::setprecision(3) << tstampDbl << " | ";
+    serialBuff << textBuffer[0] << " @ ";
+    serialBuff << std::setw(4) << std::setfill('0') << std::hex << m_words.LowPort() << std::setfill(' ') << "h\n";
+    return true;
 }
 
 MenuEntry UserInterface::GetMenuEntry(uint index)
@@ -289,8 +1110,35 @@ MenuEntry UserInterface::GetMenuEntry(uint index)
     }
 }
 
+bool UserInterface::UpdateLane(uint16_t address, uint8_t data)
+{
+    size_t lane = 0;
+    while (lane < m_laneCount && m_lanePort[lane] != address) {
+        lane++;
+    }
+
+    if (lane == m_laneCount) {
+        if (m_laneCount == c_maxLanes) {
+            // Out of lanes, this port only goes to serial
+            return data != m_lastData;
+        }
+        m_lanePort[lane] = address;
+        m_laneData[lane] = 0x0100;
+        m_laneCount++;
+    }
+
+    if (m_laneData[lane] == data) {
+        return false;
+    }
+
+    m_laneData[lane] = data;
+    sprintf(m_laneText[lane], "%02X", data);
+    return true;
+}
+
 void UserInterface::HistoryShift()
 {
+    m_codeText = nullptr; // Whatever goes in textBuffer[0] next sets it again
     for (uint i = c_maxHistory - 1; i > 0; i--) {
         memcpy(textBuffer[i], textBuffer[i - 1], c_maxStrlen);
     }
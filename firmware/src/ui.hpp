@@ -7,10 +7,19 @@
 #ifndef PICOPOST_UI_HPP
 #define PICOPOST_UI_HPP
 
+#include "beeps.hpp"
 #include "common.hpp"
+#include "console.hpp"
+#include "fingerprint.hpp"
+#include "golden.hpp"
+#include "heatmap.hpp"
+#include "postcodes.hpp"
+#include "profiler.hpp"
+#include "wordcode.hpp"
 #include "hardware/i2c.h"
 #include "sh1106.hpp"
 #include "ssd1306.hpp"
+#include <sstream>
 #include <utility>
 #include <vector>
 
@@ -33,15 +42,118 @@ public:
     void SetMenuContext(const std::vector<MenuEntry>& menu);
     void DrawMenu(uint index);
 
-    void NewData(const QueueData* buffer, const size_t elements, const bool writeToOled = true);
+    void NewData(const BusEvent* buffer, const size_t elements, const bool writeToOled = true);
+    /**
+     * @brief Drops bus data without printing it, keeping the clock in sync.
+     * Resets are still shown, and a gap marker reports what was skipped.
+     *
+     * @param reportGap If false, everything is dropped quietly, resets too
+     * @return Number of data events dropped
+     */
+    size_t SkipData(const BusEvent* buffer, const size_t elements, const bool reportGap = true);
+
+    void NewData(const VoltageSample* buffer, const size_t elements, const bool writeToOled = true);
+    void NewData(const ClockSample* buffer, const size_t elements, const bool writeToOled = true);
+    /**
+     * @brief Shows the busiest ports, as returned by PortHeatmap::Top(), with
+     * their device names. The first c_heatmapColumns go to the OLED.
+     *
+     * @param total Writes counted so far, busy ports get a share of it
+     */
+    void NewData(const PortHeatmap::Entry* buffer, const size_t elements, const uint32_t total,
+        const bool writeToOled = true);
 
     void ClearBuffers();
 
+    /**
+     * @brief Gives each matched port its own lane on the OLED, instead of the
+     * single history line. Lanes are handed out to ports as they show up.
+     */
+    void SetLanes(bool enabled);
+
+    /**
+     * @brief Shows bytes written to the two ports in config as a single
+     * 16-bit code, on 4 digits, instead of one byte at a time.
+     */
+    void SetWords(bool enabled, const WordAssembler& config);
+
+    /**
+     * @brief Decodes COM1, E9h and CMOS writes into text and records, instead
+     * of showing them byte by byte. See ConsoleDecoder.
+     */
+    void SetConsole(bool enabled);
+
+    /**
+     * @brief Turns PIT channel 2 and port 61h writes into beep codes, shown
+     * next to the latest POST codes. See BeepDecoder.
+     */
+    void SetBeeps(bool enabled);
+
+    /**
+     * @brief Times how long each POST code stays on, from reset deassertion
+     * onwards, and shows the slowest ones. The full table goes over USB at
+     * every reset, or on PrintProfile(). See PostProfiler.
+     */
+    void SetProfiler(bool enabled);
+    void PrintProfile();
+
+    /**
+     * @brief Checks each boot against the golden reference as POST codes come
+     * in, and shows PASS or FAIL with the reason. See GoldenMatcher.
+     */
+    void SetGolden(bool enabled);
+
+    /**
+     * @brief Picks whose POST code descriptions go next to the codes, on USB
+     * and under them on 64 px displays. BiosVendor::None turns them off.
+     */
+    void SetCodeDatabase(BiosVendor vendor);
+    BiosVendor GetCodeDatabase() const;
+
+    /**
+     * @brief Looks for the BIOS vendor and version in the first codes of each
+     * boot, on all POST ports. Once sure, picks the matching descriptions with
+     * SetCodeDatabase() and only follows the port it was found on. See
+     * BiosFingerprint.
+     */
+    void SetFingerprint(bool enabled);
+
+    /**
+     * @brief Gives access to the reference and its settings. Call
+     * RefreshGolden() after changing anything.
+     */
+    GoldenMatcher& GetGolden();
+    void RefreshGolden();
+    void PrintGolden();
+
+    /**
+     * @brief Shows what decoders are still holding on to: a half code waiting
+     * for its partner, console text that's been waiting too long for its end
+     * of line, or a beep code followed by enough silence. Call when no bus
+     * data is pending.
+     */
+    void ExpirePending();
+
     MenuEntry GetMenuEntry(uint index);
 
     inline size_t GetMenuSize() const { return currentMenu.size(); }
 
 private:
+    enum class OLEDRefreshOperation {
+        None,
+        Volts,
+        Clock,
+        Bus,
+        Lanes,
+        Words,
+        Heatmap,
+        Console,
+        Beeps,
+        Profile,
+        Golden,
+        Fingerprint,
+    };
+
     struct SpritePosition {
         int16_t x;
         int16_t y;
@@ -53,6 +165,13 @@ private:
 
     static const size_t c_maxHistory { 10 };
     static const size_t c_maxStrlen { 15 };
+    static const size_t c_maxLanes { 4 };
+    static const size_t c_heatmapColumns { 3 };
+    static const size_t c_consoleColumns { 19 };
+    static const size_t c_profileRows { 3 }; // Two slowest stages each, only the first one fits on 32 px
+    static const size_t c_describeColumns { 21 }; // Full width in 5x8
+    static const size_t c_describeRows { 3 }; // Below the history on 64 px only
+    static const uint64_t c_consoleIdleUs { 250000 }; // Partial lines wait this long for more text
     static const std::vector<MenuEntry> s_mainMenu;
 
     pico_oled::OLED* display { nullptr };
@@ -63,8 +182,50 @@ private:
     char textBuffer[c_maxHistory][c_maxStrlen] { '\0' };
     SpritePosition spritePos { 0 };
     uint16_t m_lastData { 0x0100 };
+    uint64_t m_busTime { 0 }; // Since last reset, sum of BusEvent deltas
+    uint64_t m_busSeenAt { 0 }; // time_us_64() when m_busTime was last updated
+    uint16_t m_repeatPort { 0 }; // Last P80Data, for P80Repeat to replay into decoders
+    uint8_t m_repeatData { 0 };
+    bool m_lanesEnabled { false };
+    size_t m_laneCount { 0 };
+    uint16_t m_lanePort[c_maxLanes] { 0 };
+    uint16_t m_laneData[c_maxLanes] { 0 };
+    char m_laneText[c_maxLanes][c_maxStrlen] { '\0' };
+    bool m_wordsEnabled { false };
+    WordAssembler m_words {};
+    uint32_t m_lastWord { UINT32_MAX }; // Value and halves, UINT32_MAX for none
+    bool m_consoleEnabled { false };
+    ConsoleDecoder m_console {};
+    uint64_t m_consoleFedAt { 0 }; // time_us_64() of the last byte decoded
+    char m_consoleText[c_consoleColumns + 1] { '\0' };
+    bool m_beepsEnabled { false };
+    BeepDecoder m_beeps {};
+    char m_beepText[c_consoleColumns + 1] { '\0' };
+    bool m_profilerEnabled { false };
+    PostProfiler m_profiler {};
+    char m_profileText[c_profileRows + 1][c_consoleColumns + 1] { '\0' };
+    bool m_goldenEnabled { false };
+    GoldenMatcher m_golden {};
+    char m_goldenText[2][c_consoleColumns + 1] { '\0' }; // Summary and details
+    BiosVendor m_codeVendor { BiosVendor::None };
+    const char* m_codeText { nullptr }; // Description of textBuffer[0], in flash
+    bool m_fingerprintEnabled { false };
+    BiosFingerprint m_fingerprint {};
+    char m_fingerprintText[c_consoleColumns + 1] { '\0' };
 
     void HistoryShift();
+    bool UpdateLane(uint16_t address, uint8_t data);
+    bool ShowWord(const WordAssembler::Code& code, std::stringstream& serialBuff);
+    void ReportProfile(uint64_t nowUs, std::stringstream& serialBuff);
+    void UpdateProfile();
+    uint64_t BusNowUs() const;
+    void ShowGolden(std::stringstream& serialBuff);
+    void ShowFingerprint(std::stringstream& serialBuff);
+    void DrawDescription(size_t columns);
+    void ShowBeeps(const BeepDecoder::Pattern& pattern, std::stringstream& serialBuff);
+    void ShowConsole(ConsoleDecoder::Source source, const char* text, std::stringstream& serialBuff);
+    OLEDRefreshOperation HistoryView() const;
+    void RefreshOled(OLEDRefreshOperation oledRefresh);
     void UpdateSpritePosition(const Sprite& spr);
 };
 
@@ -0,0 +1,161 @@
+/**
+ * @file wordcode.hpp
+ * @brief Pairs bytes written to two adjacent ports into 16-bit POST codes.
+ *
+ */
+
+#ifndef PICOPOST_WORDCODE_HPP
+#define PICOPOST_WORDCODE_HPP
+
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief Puts wide POST codes back together from their two halves.
+ *
+ * @par
+ * A word written to 80h shows up on an 8-bit slot as two byte cycles, one to
+ * 80h and one to 81h, and some boards write companion bytes to 84h/85h with
+ * separate instructions. Whichever half comes first is held until the other
+ * one shows up, as long as it does within the pairing window. A half left on
+ * its own, because the window expired or the same half came again, goes out
+ * alone, so nothing is ever lost.
+ *
+ * @par
+ * Time is whatever the caller counts in, as long as it's the same for Feed()
+ * and the window. The textual form, used by the USB "word" command, is the
+ * low port in hex, optionally followed by the window in microseconds:
+ * "80" or "84 200".
+ */
+class WordAssembler {
+public:
+    static constexpr uint32_t c_defaultWindowUs { 100 };
+    static constexpr uint32_t c_maxWindowUs { 10000 };
+
+    struct Code {
+        uint16_t value { 0 };
+        bool haveLow { false };
+        bool haveHigh { false };
+    };
+
+    uint16_t LowPort() const
+    {
+        return lowPort;
+    }
+
+    uint16_t HighPort() const
+    {
+        return static_cast<uint16_t>(lowPort + 1);
+    }
+
+    uint32_t WindowUs() const
+    {
+        return windowUs;
+    }
+
+    bool Matches(uint16_t port) const
+    {
+        return port == LowPort() || port == HighPort();
+    }
+
+    // Forgets the pending half, if any
+    void Reset()
+    {
+        pending = {};
+    }
+
+    /**
+     * @brief Adds a byte written to either port. Codes that got completed,
+     * or left alone, go to emit, oldest first.
+     *
+     * @param window Pairing window, in the same units as at
+     */
+    template <typename Emit>
+    void Feed(uint64_t at, uint64_t window, uint16_t port, uint8_t data, Emit&& emit)
+    {
+        const bool high = (port == HighPort());
+        if (pending.code.haveLow || pending.code.haveHigh) {
+            const bool other = high ? !pending.code.haveHigh : !pending.code.haveLow;
+            if (other && at - pending.at <= window) {
+                pending.code.value |= static_cast<uint16_t>(high ? (data << 8) : data);
+                pending.code.haveLow = pending.code.haveHigh = true;
+                emit(pending.code);
+                Reset();
+                return;
+            }
+            Flush(emit);
+        }
+
+        pending.at = at;
+        pending.code = {
+            .value = static_cast<uint16_t>(high ? (data << 8) : data),
+            .haveLow = !high,
+            .haveHigh = high,
+        };
+    }
+
+    // Sends out the pending half on its own, once its pairing window is over by `at`
+    template <typename Emit>
+    void Expire(uint64_t at, uint64_t window, Emit&& emit)
+    {
+        if ((pending.code.haveLow || pending.code.haveHigh) && at - pending.at > window) {
+            Flush(emit);
+        }
+    }
+
+    // Sends out the pending half, if any, on its own
+    template <typename Emit>
+    void Flush(Emit&& emit)
+    {
+        if (pending.code.haveLow || pending.code.haveHigh) {
+            emit(pending.code);
+            Reset();
+        }
+    }
+
+    /**
+     * @brief Replaces ports and window with the ones in spec.
+     *
+     * @return false if spec is malformed, nothing is changed then
+     */
+    bool Parse(std::string_view spec)
+    {
+        const size_t space = spec.find(' ');
+        const std::string_view portText = spec.substr(0, space);
+        const std::string_view windowText = (space == std::string_view::npos) ? std::string_view {} : spec.substr(space + 1);
+
+        uint16_t port = 0;
+        auto result = std::from_chars(portText.data(), portText.data() + portText.size(), port, 16);
+        if (portText.empty() || result.ec != std::errc {} || result.ptr != portText.data() + portText.size()
+            || port == UINT16_MAX) {
+            return false;
+        }
+
+        uint32_t window = c_defaultWindowUs;
+        if (!windowText.empty()) {
+            result = std::from_chars(windowText.data(), windowText.data() + windowText.size(), window, 10);
+            if (result.ec != std::errc {} || result.ptr != windowText.data() + windowText.size()
+                || window == 0 || window > c_maxWindowUs) {
+                return false;
+            }
+        }
+
+        lowPort = port;
+        windowUs = window;
+        Reset();
+        return true;
+    }
+
+private:
+    struct Pending {
+        Code code {};
+        uint64_t at { 0 };
+    };
+
+    uint16_t lowPort { 0x80 };
+    uint32_t windowUs { c_defaultWindowUs };
+    Pending pending {};
+};
+
+#endif // PICOPOST_WORDCODE_HPP
@@ -0,0 +1,43 @@
+/**
+ * @file check.hpp
+ * @brief Bare minimum for the host-side unit tests: checks that keep going on
+ * failure, and a tally for main() to return.
+ *
+ */
+
+#ifndef PICOPOST_TEST_CHECK_HPP
+#define PICOPOST_TEST_CHECK_HPP
+
+#include <cstdio>
+
+inline int g_failures = 0;
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_failures++;                                                       \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                          \
+    do {                                                                        \
+        const auto lhs_ = (a);                                                  \
+        const auto rhs_ = (b);                                                  \
+        if (!(lhs_ == rhs_)) {                                                  \
+            std::printf("%s:%d: check failed: %s == %s (%lld vs %lld)\n",       \
+                __FILE__, __LINE__, #a, #b,                                     \
+                static_cast<long long>(lhs_), static_cast<long long>(rhs_));    \
+            g_failures++;                                                       \
+        }                                                                       \
+    } while (0)
+
+// Runs a test function, and reports how it went
+#define RUN(test)                                                               \
+    do {                                                                        \
+        const int before_ = g_failures;                                         \
+        test();                                                                 \
+        std::printf("%s %s\n", (g_failures == before_) ? "PASS" : "FAIL", #test); \
+    } while (0)
+
+#endif // PICOPOST_TEST_CHECK_HPP
@@ -0,0 +1,306 @@
+/**
+ * @file test_dmahandoff.cpp
+ * @brief DmaHandoff and BlockRing against a simulated RX FIFO and DMA channel pair.
+ *
+ */
+
+#include "check.hpp"
+#include "dmahandoff.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace {
+
+constexpr size_t c_blockWords { 16 };
+constexpr size_t c_blockCount { 4 };
+
+using Ring = BlockRing<uint32_t, c_blockWords, c_blockCount>;
+using Handoff = DmaHandoff<uint32_t, c_blockWords, c_blockCount>;
+
+// Data, control and retire channel of one lane, fed one word at a time from the
+// RX FIFO. Words are numbered in the order they come off the bus.
+struct FakeDma {
+    Ring ring {};
+    std::array<uint32_t, c_blockWords> discard {};
+    Handoff handoff {};
+    size_t controlRead { 0 }; // Control channel read index, wraps like the hardware ring
+    uintptr_t writeAddr { 0 };
+    size_t transCount { 0 };
+    bool irq { false };
+    uint32_t next { 0 };
+    uint32_t strayLoads { 0 };
+
+    void Start()
+    {
+        ring.Reset();
+        handoff.Reset(&ring, discard.data());
+        Load();
+    }
+
+    // Control channel: next table entry to the data channel's write address
+    // trigger, then the retire channel puts the discard entry in its place
+    void Load()
+    {
+        writeAddr = handoff.Table()[controlRead];
+        handoff.Table()[controlRead] = *handoff.DiscardEntry();
+        controlRead = (controlRead + 1) % Handoff::c_slots;
+        transCount = c_blockWords;
+        irq = true;
+        if (!ValidBlock(writeAddr)) {
+            strayLoads++;
+        }
+    }
+
+    void Push(size_t words = 1)
+    {
+        for (size_t i = 0; i < words; i++) {
+            *reinterpret_cast<uint32_t*>(writeAddr) = next++;
+            writeAddr += sizeof(uint32_t);
+            if (--transCount == 0) {
+                // Chained to the control channel
+                Load();
+            }
+        }
+    }
+
+    void Isr()
+    {
+        if (irq) {
+            irq = false;
+            handoff.Advance(controlRead);
+        }
+    }
+
+    // Pushes with the IRQ serviced after each word, as on a healthy system
+    void PushServiced(size_t words)
+    {
+        for (size_t i = 0; i < words; i++) {
+            Push();
+            Isr();
+        }
+    }
+
+    // Only the discard buffer or the start of a ring block may ever be loaded
+    bool ValidBlock(uintptr_t addr) const
+    {
+        if (addr == reinterpret_cast<uintptr_t>(discard.data())) {
+            return true;
+        }
+        // Blocks are the ring's first member
+        const uintptr_t base = reinterpret_cast<uintptr_t>(&ring);
+        const uintptr_t blockBytes = c_blockWords * sizeof(uint32_t);
+        return addr >= base && addr < base + c_blockCount * blockBytes && (addr - base) % blockBytes == 0;
+    }
+};
+
+// Capture loop stand-in: reads whatever is available, checks order. Losses
+// reported by the ring have to account for any jump, right where it happens.
+struct Reader {
+    uint32_t expect { 0 };
+    uint32_t read { 0 };
+    uint32_t lost { 0 };
+    uint32_t skipped { 0 }; // Jumps the ring didn't account for
+    uint32_t outOfOrder { 0 };
+
+    void Drain(FakeDma& dma)
+    {
+        while (true) {
+            const auto words = dma.ring.Peek(dma.handoff.Landed(dma.writeAddr));
+            if (words.empty()) {
+                return;
+            }
+            const uint32_t taken = dma.ring.TakeLost();
+            expect += taken;
+            lost += taken;
+            for (const uint32_t word : words) {
+                if (word < expect) {
+                    outOfOrder++;
+                } else {
+                    skipped += word - expect;
+                }
+                expect = word + 1;
+                read++;
+            }
+            dma.ring.Release(words.size());
+        }
+    }
+};
+
+void TestWrapAround()
+{
+    FakeDma dma;
+    Reader reader;
+    dma.Start();
+
+    // Many times round the ring, read in uneven bites, in-flight blocks included
+    const size_t total = c_blockWords * c_blockCount * 10;
+    for (size_t pushed = 0; pushed < total; pushed += 5) {
+        dma.PushServiced(5);
+        reader.Drain(dma);
+        CHECK_EQ(reader.read, dma.next);
+    }
+
+    CHECK_EQ(reader.skipped, 0u);
+    CHECK_EQ(reader.lost, 0u);
+    CHECK_EQ(reader.outOfOrder, 0u);
+    CHECK_EQ(dma.handoff.Discarded(), 0u);
+    CHECK_EQ(dma.ring.Overruns(), 0u);
+    CHECK_EQ(dma.strayLoads, 0u);
+}
+
+void TestInFlightPeek()
+{
+    FakeDma dma;
+    Reader reader;
+    dma.Start();
+
+    // Nothing landed yet
+    dma.Isr();
+    reader.Drain(dma);
+    CHECK_EQ(reader.read, 0u);
+
+    // A partial block is readable as soon as it lands, no completion needed
+    dma.Push(3);
+    reader.Drain(dma);
+    CHECK_EQ(reader.read, 3u);
+
+    // A full block isn't, until the IRQ got to it
+    dma.Push(c_blockWords - 3);
+    reader.Drain(dma);
+    CHECK_EQ(reader.read, 3u);
+    dma.Isr();
+    reader.Drain(dma);
+    CHECK_EQ(reader.read, c_blockWords);
+    CHECK_EQ(reader.skipped, 0u);
+}
+
+void TestLateIsr()
+{
+    FakeDma dma;
+    Reader reader;
+    dma.Start();
+    dma.Isr();
+
+    // Both armed blocks complete before the IRQ runs, then three more go by
+    dma.Push(c_blockWords * 5 + 1);
+    CHECK_EQ(dma.strayLoads, 0u);
+    dma.Isr();
+
+    reader.Drain(dma);
+    CHECK_EQ(reader.read, c_blockWords * 2);
+    CHECK_EQ(reader.skipped, 0u);
+    CHECK_EQ(dma.handoff.Discarded(), 3u);
+
+    // Back on track after the block in flight, which is a discarded one too.
+    // The loss shows up right before the first block that made it.
+    dma.PushServiced(c_blockWords * 3);
+    reader.Drain(dma);
+    CHECK_EQ(reader.skipped, 0u);
+    CHECK_EQ(reader.lost, c_blockWords * dma.handoff.Discarded());
+    CHECK_EQ(dma.handoff.Discarded(), 4u);
+    CHECK_EQ(reader.read + reader.lost, dma.next);
+    CHECK_EQ(reader.outOfOrder, 0u);
+    CHECK_EQ(dma.strayLoads, 0u);
+}
+
+void TestVeryLateIsr()
+{
+    FakeDma dma;
+    Reader reader;
+    dma.Start();
+    dma.Isr();
+
+    // The control channel goes round the table more than once: the armed
+    // blocks aren't written to again, only the discarded count comes out short
+    dma.Push(c_blockWords * (Handoff::c_slots * 2 + 3) + 2);
+    CHECK_EQ(dma.strayLoads, 0u);
+    dma.Isr();
+    reader.Drain(dma);
+    CHECK_EQ(reader.read, c_blockWords * 2);
+    CHECK_EQ(reader.skipped, 0u);
+
+    dma.PushServiced(c_blockWords * 4);
+    reader.Drain(dma);
+    CHECK_EQ(reader.outOfOrder, 0u);
+    CHECK_EQ(dma.strayLoads, 0u);
+    CHECK(reader.read > c_blockWords * 2);
+}
+
+void TestOverrun()
+{
+    FakeDma dma;
+    Reader reader;
+    dma.Start();
+
+    // Reader stalls while the DMA keeps going: the ring fills, the rest is discarded
+    dma.PushServiced(c_blockWords * 7);
+    CHECK(dma.ring.Overruns() > 0);
+    CHECK_EQ(dma.strayLoads, 0u);
+
+    reader.Drain(dma);
+    CHECK_EQ(reader.read, c_blockWords * c_blockCount);
+    CHECK_EQ(reader.skipped, 0u);
+    CHECK_EQ(reader.lost, 0u);
+
+    // Once there's room again, capture picks up where the ring had a free
+    // block. The discarded ones are reported right before it, not earlier.
+    dma.PushServiced(c_blockWords * 4);
+    reader.Drain(dma);
+    CHECK_EQ(reader.outOfOrder, 0u);
+    CHECK_EQ(reader.skipped, 0u);
+    CHECK_EQ(reader.lost, c_blockWords * dma.handoff.Discarded());
+    CHECK_EQ(reader.read + reader.lost, dma.next);
+    CHECK_EQ(dma.strayLoads, 0u);
+
+    // Every block was either read in full or discarded
+    CHECK_EQ(reader.read, c_blockWords * (7 + 4 - dma.handoff.Discarded()));
+}
+
+void TestLossPosition()
+{
+    FakeDma dma;
+    Reader reader;
+    dma.Start();
+
+    // Ring fills up, and blocks get discarded
+    dma.PushServiced(c_blockWords * 6);
+    CHECK(dma.handoff.Discarded() > 0);
+
+    // Reader frees one block, and the DMA gets a real one again after the
+    // discarded ones, with three older blocks still waiting to be read
+    const auto first = dma.ring.Peek();
+    CHECK_EQ(dma.ring.TakeLost(), 0u);
+    dma.ring.Release(first.size());
+    dma.PushServiced(c_blockWords * 2);
+
+    // The loss only comes up once those three were read
+    reader.expect = c_blockWords;
+    for (size_t block = 0; block < c_blockCount - 1; block++) {
+        const auto words = dma.ring.Peek();
+        CHECK_EQ(words.size(), c_blockWords);
+        CHECK_EQ(dma.ring.TakeLost(), 0u);
+        CHECK_EQ(words.front(), reader.expect);
+        reader.expect += c_blockWords;
+        dma.ring.Release(words.size());
+    }
+    dma.PushServiced(3);
+    reader.Drain(dma);
+    CHECK_EQ(reader.read, 3u);
+    CHECK_EQ(reader.lost, c_blockWords * dma.handoff.Discarded());
+    CHECK_EQ(reader.skipped, 0u);
+    CHECK_EQ(reader.outOfOrder, 0u);
+}
+
+} // namespace
+
+int main()
+{
+    RUN(TestWrapAround);
+    RUN(TestInFlightPeek);
+    RUN(TestLateIsr);
+    RUN(TestVeryLateIsr);
+    RUN(TestOverrun);
+    RUN(TestLossPosition);
+    return g_failures == 0 ? 0 : 1;
+}
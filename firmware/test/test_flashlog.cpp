@@ -0,0 +1,270 @@
+/**
+ * @file test_flashlog.cpp
+ * @brief FlashLog against a flash chip simulated in RAM.
+ *
+ */
+
+#include "check.hpp"
+#include "flashlog.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Stand-in for PicoFlash: erasing sets every bit, programming can only clear
+// them, like NOR flash does. Starts out with garbage, not blank.
+struct RamFlash {
+    static constexpr size_t c_pageSize { 256 };
+    static constexpr size_t c_sectorSize { 4096 };
+
+    std::vector<uint8_t> memory = std::vector<uint8_t>(c_sectorSize * 6, 0x5A);
+    std::vector<uint32_t> erases = std::vector<uint32_t>(6, 0);
+    uint32_t dirtyPrograms { 0 }; // Pages programmed without being erased first
+
+    size_t Sectors() const
+    {
+        return memory.size() / c_sectorSize;
+    }
+
+    const uint8_t* Read(size_t offset) const
+    {
+        return memory.data() + offset;
+    }
+
+    void Erase(size_t sector)
+    {
+        std::fill_n(memory.begin() + sector * c_sectorSize, c_sectorSize, 0xFF);
+        erases[sector]++;
+    }
+
+    void Program(size_t offset, const uint8_t* page)
+    {
+        for (size_t idx = 0; idx < c_pageSize; idx++) {
+            if (memory[offset + idx] != 0xFF) {
+                dirtyPrograms++;
+                break;
+            }
+        }
+        for (size_t idx = 0; idx < c_pageSize; idx++) {
+            memory[offset + idx] &= page[idx];
+        }
+    }
+};
+
+using Log = FlashLog<RamFlash>;
+using Session = Log::Session;
+
+BusEvent PostCode(uint32_t delta, uint8_t code, uint16_t port = 0x80)
+{
+    return { .delta = delta, .address = port, .data = code, .operation = QueueOperation::P80Data };
+}
+
+BusEvent ResetCleared(uint32_t delta)
+{
+    return { .delta = delta, .address = 150, .operation = QueueOperation::P80ResetCleared };
+}
+
+bool SameEvent(const BusEvent& lhs, const BusEvent& rhs)
+{
+    return lhs.delta == rhs.delta && lhs.address == rhs.address && lhs.data == rhs.data
+        && lhs.operation == rhs.operation;
+}
+
+std::vector<Session> ListSessions(const Log& log)
+{
+    std::vector<Session> sessions {};
+    log.ForEachSession([&sessions](const Session& session) { sessions.push_back(session); });
+    return sessions;
+}
+
+std::vector<BusEvent> ReplaySession(const Log& log, uint32_t id)
+{
+    std::vector<BusEvent> events {};
+    log.Replay(id, [&events](const BusEvent& event) { events.push_back(event); });
+    return events;
+}
+
+// One boot of the host, serviced the way the capture loop does, never dropping anything
+std::vector<BusEvent> RecordBoot(Log& log, uint32_t seed, size_t count)
+{
+    std::vector<BusEvent> events { ResetCleared(seed * 1000) };
+    for (size_t idx = 0; idx < count; idx++) {
+        // Mostly small steps, now and then a long silence or another port
+        const uint32_t delta = (idx % 97 == 0) ? 0x80000000u + seed : (idx * 37 + seed) % 3000;
+        const uint16_t port = (idx % 13 == 0) ? 0x84 : 0x80;
+        events.push_back(PostCode(delta, static_cast<uint8_t>(idx + seed), port));
+    }
+    for (const BusEvent& event : events) {
+        if (!log.Add(event)) {
+            CHECK(false);
+        }
+        log.Service(false);
+    }
+    return events;
+}
+
+void TestListReplay()
+{
+    Log log;
+    CHECK(log.Start());
+    const auto first = RecordBoot(log, 1, 100);
+    const auto second = RecordBoot(log, 2, 250);
+    log.Finish();
+
+    // Two sessions, oldest first, split at the reset deassertion
+    const auto sessions = ListSessions(log);
+    CHECK_EQ(sessions.size(), 2u);
+    if (sessions.size() != 2) {
+        return;
+    }
+    CHECK(sessions[0].id < sessions[1].id);
+    CHECK_EQ(sessions[0].events, first.size());
+    CHECK_EQ(sessions[1].events, second.size());
+    CHECK(!sessions[0].truncated);
+    CHECK(!sessions[1].truncated);
+
+    // Replay gives back exactly what went in
+    uint64_t ticks = 0;
+    const auto replayed = ReplaySession(log, sessions[1].id);
+    CHECK_EQ(replayed.size(), second.size());
+    for (size_t idx = 0; idx < std::min(replayed.size(), second.size()); idx++) {
+        CHECK(SameEvent(replayed[idx], second[idx]));
+        ticks += second[idx].delta;
+    }
+    CHECK_EQ(sessions[1].ticks, ticks);
+    CHECK(!log.Replay(sessions[1].id + 1, [](const BusEvent&) {}));
+
+    // After a power cycle, the same sessions are found, and the next one gets a new id
+    Log rebooted;
+    rebooted.Device() = log.Device();
+    CHECK(rebooted.Mount());
+    const auto remounted = ListSessions(rebooted);
+    CHECK_EQ(remounted.size(), 2u);
+    CHECK(rebooted.Start());
+    RecordBoot(rebooted, 3, 10);
+    rebooted.Finish();
+    const auto third = ListSessions(rebooted);
+    CHECK_EQ(third.size(), 3u);
+    CHECK(third.back().id > sessions[1].id);
+    CHECK_EQ(rebooted.Device().dirtyPrograms, 0u);
+}
+
+void TestSectorWrap()
+{
+    RamFlash flash {};
+    std::vector<std::vector<BusEvent>> boots {};
+
+    // Way more than the region holds, over a few power cycles
+    for (uint32_t cycle = 0; cycle < 8; cycle++) {
+        Log log;
+        log.Device() = flash;
+        CHECK(log.Start());
+        for (uint32_t boot = 0; boot < 4; boot++) {
+            boots.push_back(RecordBoot(log, static_cast<uint32_t>(boots.size()), 200 + boot * 80));
+        }
+        log.Finish();
+        flash = log.Device();
+    }
+
+    Log log;
+    log.Device() = flash;
+    CHECK(log.Mount());
+
+    // The newest sessions made it whole, only the oldest one left may have lost its start
+    const auto sessions = ListSessions(log);
+    CHECK(!sessions.empty());
+    CHECK(sessions.size() < boots.size());
+    for (size_t idx = 0; idx < sessions.size(); idx++) {
+        const Session& session = sessions[idx];
+        if (idx > 0) {
+            CHECK(!session.truncated);
+            CHECK(session.id > sessions[idx - 1].id);
+        }
+
+        // Ids follow the boots, whatever the power cycles
+        const auto& boot = boots[session.id - 1];
+        const auto replayed = ReplaySession(log, session.id);
+        CHECK_EQ(replayed.size(), session.events);
+        CHECK(replayed.size() <= boot.size());
+        if (!session.truncated) {
+            CHECK_EQ(replayed.size(), boot.size());
+        }
+
+        // Whatever is left of a session is its tail
+        const size_t skip = boot.size() - std::min(boot.size(), replayed.size());
+        for (size_t event = 0; event < replayed.size(); event++) {
+            CHECK(SameEvent(replayed[event], boot[skip + event]));
+        }
+    }
+    CHECK(!sessions.empty() && sessions.back().id == boots.size());
+
+    // Round robin: every sector went through the same number of erases, give or take one
+    const auto stats = log.GetStats();
+    CHECK(stats.maxErases > 2);
+    CHECK(stats.maxErases - stats.minErases <= 1);
+    CHECK(stats.reserve > 0);
+    const auto [fewest, most] = std::minmax_element(flash.erases.begin(), flash.erases.end());
+    CHECK(*most - *fewest <= 1);
+    CHECK_EQ(log.Device().dirtyPrograms, 0u);
+}
+
+void TestReservedSlot()
+{
+    Log log;
+    CHECK(log.Start());
+
+    // Nothing serviced: blocks pile up in RAM, but the last slot isn't handed out
+    std::vector<BusEvent> stored {};
+    uint8_t code = 0;
+    while (log.Add(PostCode(10, ++code))) {
+        stored.push_back(PostCode(10, code));
+    }
+    CHECK(log.Pending(false));
+    CHECK_EQ(log.GetStats().dropped, 1u);
+
+    // Nothing is erased yet, so the first block has to wait for an erase. That
+    // sector's header goes through the spare slot, the queued blocks stay intact.
+    log.Service(false);
+    CHECK(!log.Pending(false));
+    CHECK_EQ(log.GetStats().forcedErases, 1u);
+    CHECK_EQ(log.GetStats().pagesUsed, Log::c_pageQueue - 1);
+
+    // The dropped event leaves a gap marker ahead of the next one that fits,
+    // with its time, so the timeline still adds up
+    const BusEvent next = PostCode(10, 0x55);
+    CHECK(log.Add(next));
+    log.Finish();
+
+    const auto sessions = ListSessions(log);
+    CHECK_EQ(sessions.size(), 1u);
+    if (sessions.empty()) {
+        return;
+    }
+    const auto replayed = ReplaySession(log, sessions[0].id);
+    CHECK_EQ(replayed.size(), stored.size() + 2);
+    for (size_t idx = 0; idx < std::min(replayed.size(), stored.size()); idx++) {
+        CHECK(SameEvent(replayed[idx], stored[idx]));
+    }
+    if (replayed.size() == stored.size() + 2) {
+        const BusEvent& gap = replayed[stored.size()];
+        CHECK(gap.operation == QueueOperation::P80Gap);
+        CHECK_EQ(gap.address, 1u);
+        CHECK_EQ(gap.data, LS_FlashLog);
+        CHECK_EQ(gap.delta, 10u);
+        CHECK(SameEvent(replayed.back(), next));
+    }
+    CHECK_EQ(sessions[0].ticks, 10u * (stored.size() + 2));
+    CHECK_EQ(log.Device().dirtyPrograms, 0u);
+}
+
+} // namespace
+
+int main()
+{
+    RUN(TestListReplay);
+    RUN(TestSectorWrap);
+    RUN(TestReservedSlot);
+    return g_failures == 0 ? 0 : 1;
+}